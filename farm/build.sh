@@ -1,3 +1,4 @@
 #!/bin/bash
 
 eosio-cpp -abigen -I include -R resource -contract farm -o farm.wasm src/farm.cpp
+eosio-cpp -abigen -I include -R resource -contract boxlp -o boxlp.wasm src/boxlp.cpp
@@ -8,6 +8,7 @@
 #include <utils.hpp>
 #include <defilend.hpp>
 #include <defibox.hpp>
+#include <boxlpmath.hpp>
 
 using namespace std;
 using namespace eosio;
@@ -26,6 +27,8 @@ public:
   static constexpr name CONTROL_FEE_ACC = name("controlfeess");
   static constexpr name BUYBACK_FEE_ACC = name("buybackfeess");
   static constexpr name PLATFORM_FEE_ACC = name("platformfees");
+  // a deferred earn is never pushed more than this many durations past the last harvest
+  static constexpr uint64_t MAX_EARN_DELAY = 8;
 
   struct strat_fee {
     uint64_t controller_fee;
@@ -67,11 +70,14 @@ public:
   ACTION setfeeacc(fee_account fee_accounts);
   ACTION setduration(uint64_t duration);
   ACTION setnexttime(uint64_t next_earn_time);
+  ACTION setpid(uint64_t pid);
+  ACTION setminearn(uint64_t min_earn);
+  ACTION setkeeper(name keeper);
   ACTION depositback(uint64_t pid, name user_account, asset quantity);
   ACTION withdraw(uint64_t pid, name user_account, int128_t want_shares);
   ACTION earn();
   ACTION earnback();
-  ACTION addliquidity();
+  ACTION addliquidity(uint64_t kept0, uint64_t kept1);
   ACTION farm();
   ACTION logdeposit(uint64_t pid, name user_account, asset want_amt, int128_t shares_added);
   ACTION logwithdraw(uint64_t pid, name user_account, asset want_amt, int128_t shares_removed);
@@ -96,10 +102,84 @@ private:
     uint64_t last_earn_time;
     uint64_t next_earn_time;
     uint64_t duration;
+    binary_extension<uint64_t> pid;
+    // earn is skipped while the projected harvest is below `min_earn` (earn token units),
+    // projected from the previous harvest: `last_earned` over `last_earn_span` seconds
+    binary_extension<uint64_t> min_earn;
+    binary_extension<uint64_t> last_earned;
+    binary_extension<uint64_t> last_earn_span;
+    // account allowed to run `earn`, the pool manager when unset
+    binary_extension<name> keeper;
   }; 
 
+  // balances held before the harvested rewards were routed, so `addliquidity` only adds the swap outputs,
+  // and the earn balance before the claim, so `earnback` only routes what the claim paid
+  TABLE earn_state_t {
+    uint64_t token0_before;
+    uint64_t token1_before;
+    bool harvested;
+    binary_extension<uint64_t> earn_before;
+  };
+
+  TABLE user_t {
+    name owner;
+    int128_t shares;
+
+    uint64_t primary_key() const { return owner.value; }
+  };
+
+  // deposits wait here for the next earn cycle, `farm` prices them at the post-harvest share price
+  // and `withdraw2` pays `payout` for refunds and for withdrawals queued before they were paid directly
+  TABLE pending_t {
+    name owner;
+    asset deposit;
+    int128_t shares;
+    asset payout;
+
+    uint64_t primary_key() const { return owner.value; }
+  };
+
   typedef eosio::singleton<"configs21"_n, config_t> configs;
   typedef multi_index<name("configs21"), config_t> configs_for_abi;
 
+  typedef eosio::singleton<"earnstate"_n, earn_state_t> earnstates;
+  typedef multi_index<name("earnstate"), earn_state_t> earnstates_for_abi;
+  typedef multi_index<name("users"), user_t> users;
+  typedef multi_index<name("pendings"), pending_t> pendings;
+
+  // leading fields of the crab farm's `pools` and `users` rows, enough to find the vault's row
+  struct crab_pool_t {
+    uint64_t pid;
+    extended_symbol want;
+    uint64_t weight;
+    uint64_t last_reward_time;
+    uint64_t reward_per_share;
+    uint64_t total_rewards;
+    uint64_t shares_total;
+    asset total_staked;
+    bool display;
+    bool enabled;
+    binary_extension<uint128_t> reward_per_weight_paid;
+    binary_extension<uint64_t> epoch;
+
+    uint64_t primary_key() const { return pid; }
+  };
+
+  struct crab_user_t {
+    name owner;
+
+    uint64_t primary_key() const { return owner.value; }
+  };
+
+  typedef multi_index<"pools"_n, crab_pool_t> crabpools;
+  typedef multi_index<"users"_n, crab_user_t> crabusers;
+
   configs _configs = configs(_self, _self.value);
+  earnstates _earnstates = earnstates(_self, _self.value);
+  users _users = users(_self, _self.value);
+  pendings _pendings = pendings(_self, _self.value);
+
+  void settle_pending(config_t &config);
+  bool farmed(const config_t &config);
+  void take_fee(const config_t &config, const name to, const uint64_t fee, const uint64_t amount, const string &memo);
 };
@@ -0,0 +1,46 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+
+// earn scheduling of the boxlp strategy, kept free of eosio dependencies so the host checks
+// in `farm/replay` compile it unchanged
+namespace boxlpmath {
+    using u128 = unsigned __int128;
+
+    struct earn_state {
+        uint64_t now_time;
+        uint64_t last_earn_time;
+        uint64_t duration;
+        uint64_t max_delay;         // in durations past the last harvest
+        bool locked;                // the vault holds settled want
+        bool queued;                // deposits wait in `pendings`
+        bool farmed;                // the crab farm has a `users` row for the vault
+        uint64_t min_earn;
+        uint64_t last_earned;
+        uint64_t last_earn_span;
+    };
+
+    struct earn_plan {
+        bool harvest;               // claim and compound
+        bool settle;                // settle the queue without a harvest
+        bool reschedule;            // the profitability gate moved `next_earn_time`
+        uint64_t next_earn_time;
+    };
+
+    // a harvest needs settled want and a farm row to claim from, it is skipped and rescheduled
+    // while the harvest projected from the last one stays below `min_earn`
+    inline earn_plan plan_earn( const earn_state &s ) {
+        earn_plan plan { s.locked && s.farmed, false, false, 0 };
+        if (plan.harvest && s.min_earn > 0 && s.last_earned > 0 && s.last_earn_span > 0) {
+            const uint64_t elapsed = s.now_time - s.last_earn_time;
+            if (static_cast<u128>(s.last_earned) * elapsed / s.last_earn_span < s.min_earn) {
+                const uint64_t needed = static_cast<uint64_t>(std::min<u128>(static_cast<u128>(s.min_earn) * s.last_earn_span / s.last_earned, static_cast<u128>(s.max_delay) * s.duration));
+                plan.harvest = false;
+                plan.reschedule = true;
+                plan.next_earn_time = std::max(s.last_earn_time + needed, s.now_time + s.duration);
+            }
+        }
+        plan.settle = !plan.harvest && s.queued;
+        return plan;
+    }
+}
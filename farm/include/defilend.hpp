@@ -1,6 +1,7 @@
 #pragma once
 
 #include <eosio/asset.hpp>
+#include <map>
 #include <utils.hpp>
 
 namespace defilend {
@@ -111,26 +112,36 @@ namespace defilend {
         return utils::get_supply({ sym, token_code }).symbol.is_valid();
     }
 
-    //get first b-token based on symcode (could be wrong if there are multiple wrapped tokens with the same symbol code)
-    static extended_symbol get_btoken( const symbol_code& symcode) {
+    // `byextsym` key of a reserve, same layout as reserves_row::get_by_extsym
+    static uint128_t get_extsym_key( const name contract, const symbol_code symcode ) {
+        return static_cast<uint128_t>(contract.value) << 64 | (uint64_t) symcode.to_string().length() << 48 | symcode.raw();
+    }
+
+    // b-tokens are the reserve symbol code prefixed with "B", so `bybsym` finds the reserve of a symbol code
+    static reserves_row get_reserve( const symbol_code& symcode ) {
+        const string code_str = symcode.to_string();
+        if(code_str.length() >= 7) return {};
         reserves reserves_tbl( code, code.value);
-        for(const auto& row: reserves_tbl) {
-            if(row.sym.code() == symcode) {
-                return { row.bsym, token_code };
-            }
-        }
-        return {};
+        auto index = reserves_tbl.get_index<"bybsym"_n>();
+        const auto it = index.find(symbol_code{ "B" + code_str }.raw());
+        if(it == index.end() || it->sym.code() != symcode) return {};
+        return *it;
     }
 
-    //get reserve based on extended symbol. There should be a secondary index for it but it needs further research
+    //get b-token based on symcode (could be wrong if there are multiple wrapped tokens with the same symbol code)
+    static extended_symbol get_btoken( const symbol_code& symcode) {
+        const auto row = get_reserve(symcode);
+        if(row.sym.code() != symcode) return {};
+        return { row.bsym, token_code };
+    }
+
+    //get reserve based on extended symbol
     static reserves_row get_reserve( const extended_symbol ext_sym) {
         reserves reserves_tbl( code, code.value);
-        for(const auto& row: reserves_tbl) {
-            if(row.sym == ext_sym.get_symbol() && row.contract == ext_sym.get_contract()) {
-                return row;
-            }
-        }
-        return {};
+        auto index = reserves_tbl.get_index<"byextsym"_n>();
+        const auto it = index.find(get_extsym_key(ext_sym.get_contract(), ext_sym.get_symbol().code()));
+        if(it == index.end() || it->sym != ext_sym.get_symbol()) return {};
+        return *it;
     }
 
     /**
@@ -154,15 +165,11 @@ namespace defilend {
      * ```
      */
     static extended_asset wrap( const asset& quantity ) {
-        reserves reserves_tbl( code, code.value);
-        for(const auto& row: reserves_tbl) {        //TODO: use secondary index (need to pass extended_asset to the method)
-            if(row.sym == quantity.symbol) {
-                const auto bsupply = utils::get_supply({ row.bsym, token_code });
-                return { static_cast<int64_t>(static_cast<int128_t>(quantity.amount) * bsupply.amount / row.practical_balance.amount), extended_symbol{ bsupply.symbol, token_code } };
-            }
-        }
-        check(false, "sx.defilend::wrap: Not lendable");
-        return {};
+        const auto row = get_reserve(quantity.symbol.code());
+        check(row.sym == quantity.symbol, "sx.defilend::wrap: Not lendable");
+
+        const auto bsupply = utils::get_supply({ row.bsym, token_code });
+        return { static_cast<int64_t>(static_cast<int128_t>(quantity.amount) * bsupply.amount / row.practical_balance.amount), extended_symbol{ bsupply.symbol, token_code } };
     }
 
     /**
@@ -289,6 +296,253 @@ namespace defilend {
     }
 
 
+    /**
+     * ## STATIC `get_liquidation_out`
+     *
+     * Calculate collateral tokens to receive when liquidating {ext_in} debt
+     * Payout = (In * Oracle_last_price_Loan) * (1 + Liquidation_bonus_col) / Oracle_last_price_Col
+     *
+     * ### params
+     *
+     * - `{extended_asset} ext_in` - amount of debt to liquidate
+     * - `{extended_symbol} ext_sym_out` - desired collateral to receive
+     * - `{vector<OraclizedAsset>} loans` - loans
+     * - `{vector<OraclizedAsset>} collaterals` - collaterals
+     *
+     * ### example
+     *
+     * ```c++
+     * // Inputs
+     * const extended_asset ext_in = { "400 USDT@tethertether" };
+     * const extended_symbol ext_sym_out = { "4,EOS@eosio.token" };
+     * const vector<OraclizedAsset> loans = { {"400 USDT", 400, 400}, {"100 EOS", 500, 500} };
+     * const vector<OraclizedAsset> collaterals = { {"500 USDT", 700, 300}, {"200 EOS", 600, 375} };
+     *
+     * // Calculation
+     * const auto out = defilend::get_liquidation_out( ext_in, ext_sym_out, loans, collaterals );
+     * // => 100 EOS
+     * ```
+     */
+    static extended_asset get_liquidation_out( const extended_asset ext_in, const extended_symbol ext_sym_out, const vector<OraclizedAsset>& loans, const vector<OraclizedAsset>& collaterals )
+    {
+        // no need to check health factor - should check before calling this function
+        // const auto hf = get_health_factor(loans, collaterals);
+        // if(hf >= 1) return { 0, ext_sym_out };
+
+        double loans_value = 0;
+        extended_asset loan_to_liquidate, coll_to_get;
+        for(const auto loan: loans){
+            if(loan.tokens.get_extended_symbol() == ext_in.get_extended_symbol() ) loan_to_liquidate = loan.tokens;
+            loans_value += loan.value;
+        }
+        for(const auto coll: collaterals){
+            if(coll.tokens.get_extended_symbol() == ext_sym_out ) coll_to_get = coll.tokens;
+        }
+        if(loan_to_liquidate.quantity.amount == 0 || loan_to_liquidate < ext_in || coll_to_get.quantity.amount == 0)
+            return { 0, ext_sym_out };
+
+        const auto& loan_res = get_reserve(ext_in.get_extended_symbol());
+        check(loan_res.sym == ext_in.quantity.symbol, "sx.defilend::get_liquidation_out: Loan not a reserve: " + ext_in.quantity.symbol.code().to_string() + "@" + ext_in.contract.to_string());
+
+        const auto& coll_res = get_reserve(ext_sym_out);
+        check(coll_res.sym == ext_sym_out.get_symbol(), "sx.defilend::get_liquidation_out: Collateral not a reserve: " + ext_sym_out.get_symbol().code().to_string() + "@" + ext_sym_out.get_contract().to_string());
+
+        prices prices_tbl( oracle_code, oracle_code.value);
+        double loan_price = 1, coll_price = 1;
+        if(loan_res.oracle_price_id){   // 0 == USDT
+            const auto row = prices_tbl.get(loan_res.oracle_price_id, "defilend::get_liquidation_out: no loan oracle");
+            loan_price = row.last_price / pow(10, row.precision);
+        }
+        if(coll_res.oracle_price_id){   // 0 == USDT
+            const auto row = prices_tbl.get(coll_res.oracle_price_id, "defilend::get_liquidation_out: no coll oracle");
+            coll_price = row.last_price / pow(10, row.precision);
+        }
+
+        // Payout = (In * Oracle_last_price_Loan) * (1 + Liquidation_bonus_col) / Oracle_last_price_Col
+        const auto usd_value = ext_in.quantity.amount / pow(10, ext_in.quantity.symbol.precision()) * loan_price;
+        const auto usd_out = usd_value * (1 + static_cast<double>(coll_res.liquidation_bonus) / 10000);
+        const int64_t out = usd_out / coll_price * pow(10, ext_sym_out.get_symbol().precision());
+
+        // print("\n  In: ", ext_in.quantity, " loan_price: ", loan_price, " coll_price: ", coll_price, " usd_value: ", usd_value, " usd_out: ", usd_out, " out: ", out);
+        if(usd_value > 0.49 * loans_value) return { 0, ext_sym_out };   //only 1/2 of loans allowed to liquidate, take 0.49 to be on the safe side
+        if(coll_to_get.quantity.amount < out) return { 0, ext_sym_out };   //can't get more than collateral
+
+        return { out, ext_sym_out };
+
+    }
+
+    // fixed-point scales of the position evaluator: values are USDT amounts * VALUE_PRECISION,
+    // health factors are ratios * HEALTH_PRECISION
+    static constexpr int128_t VALUE_PRECISION = 1000000;
+    static constexpr int128_t HEALTH_PRECISION = 10000;
+
+    struct PositionAsset {
+        extended_asset tokens;
+        uint64_t reserve_id;
+        int128_t value;
+        int128_t ratioed;
+    };
+
+    struct Position {
+        vector<PositionAsset> collaterals;
+        vector<PositionAsset> loans;
+        int128_t collateral_value = 0;
+        int128_t ratioed_value = 0;
+        int128_t loan_value = 0;
+        int128_t health_factor = 0;     // 0 when there are no loans
+    };
+
+    static int128_t pow10( uint8_t exp ) {
+        check(exp <= 38, "defilend: precision overflow");
+        int128_t res = 1;
+        while(exp--) res *= 10;
+        return res;
+    }
+
+    // a * b for non-negative operands, aborts instead of wrapping
+    static int128_t mul( const int128_t a, const int128_t b ) {
+        static constexpr int128_t max = static_cast<int128_t>(~static_cast<uint128_t>(0) >> 1);
+        check(a >= 0 && b >= 0 && (b == 0 || a <= max / b), "defilend: value overflow");
+        return a * b;
+    }
+
+    /**
+     * ## STRUCT `evaluator`
+     *
+     * Evaluates lend.defi positions with integer math. Reserve, b-token supply and oracle rows are read
+     * once and cached, so one evaluator can check many accounts in a loop
+     *
+     * ### example
+     *
+     * ```c++
+     * defilend::evaluator eval;
+     * const auto pos = eval.evaluate( "myusername"_n );
+     * // pos.health_factor => 12345 (1.2345)
+     *
+     * const auto out = eval.get_liquidation_out( pos, { "400 USDT@tethertether" }, { "4,EOS@eosio.token" } );
+     * // => 100 EOS
+     * ```
+     */
+    struct evaluator {
+        reserves reserves_tbl { code, code.value };
+        prices prices_tbl { oracle_code, oracle_code.value };
+        std::map<uint64_t, reserves_row> reserve_cache;
+        std::map<uint64_t, int64_t> bsupply_cache;
+        std::map<uint64_t, oracle_row> price_cache;
+
+        const reserves_row& get_reserve( const uint64_t reserve_id ) {
+            auto it = reserve_cache.find(reserve_id);
+            if(it == reserve_cache.end()) it = reserve_cache.emplace(reserve_id, reserves_tbl.get(reserve_id, "defilend: no reserve")).first;
+            return it->second;
+        }
+
+        int64_t get_bsupply( const reserves_row& reserve ) {
+            auto it = bsupply_cache.find(reserve.id);
+            if(it == bsupply_cache.end()) it = bsupply_cache.emplace(reserve.id, utils::get_supply({ reserve.bsym, token_code }).amount).first;
+            return it->second;
+        }
+
+        const oracle_row& get_price( const uint64_t oracle_id ) {
+            auto it = price_cache.find(oracle_id);
+            if(it == price_cache.end()) it = price_cache.emplace(oracle_id, prices_tbl.get(oracle_id, "defilend: no oracle")).first;
+            return it->second;
+        }
+
+        // value of {tokens} in VALUE_PRECISION units, priced with the oracle average like `get_value`
+        int128_t get_value( const extended_asset& tokens, const uint64_t oracle_id ) {
+            const uint8_t precision = tokens.quantity.symbol.precision();
+            if(tokens.get_extended_symbol() == value_symbol)
+                return mul(tokens.quantity.amount, VALUE_PRECISION) / pow10(precision);
+
+            const auto& row = get_price(oracle_id);
+            return mul(mul(tokens.quantity.amount, row.avg_price), VALUE_PRECISION) / pow10(precision + row.precision);
+        }
+
+        Position evaluate( const name account ) {
+            Position pos;
+            userconfigs configs_tbl(code, account.value);
+            for(const auto& row: configs_tbl) {
+                if(!row.use_as_collateral) continue;
+                const auto& reserve = get_reserve(row.reserve_id);
+                const auto bdeposit = utils::get_balance({ reserve.bsym, token_code }, account ).quantity;
+                if(bdeposit.amount == 0) continue;
+                const int128_t tokens_amount = static_cast<int128_t>(reserve.practical_balance.amount) * bdeposit.amount / get_bsupply(reserve);
+                if(tokens_amount == 0) continue;
+                const extended_asset ext_tokens = { static_cast<int64_t>(tokens_amount), { reserve.practical_balance.symbol, reserve.contract } };
+                const int128_t value = get_value(ext_tokens, reserve.oracle_price_id);
+                const int128_t ratioed = mul(value, reserve.liquidation_threshold) / 10000;
+                pos.collaterals.push_back({ ext_tokens, reserve.id, value, ratioed });
+                pos.collateral_value += value;
+                pos.ratioed_value += ratioed;
+            }
+
+            userreserves userreserves_tbl(code, account.value);
+            const auto now = eosio::current_time_point().sec_since_epoch();
+            for(const auto& row: userreserves_tbl) {
+                const auto& reserve = get_reserve(row.reserve_id);
+                const int128_t secs = now - reserve.last_update_time.sec_since_epoch();
+                const int128_t rate1 = reserve.current_variable_borrow_rate * secs / (365*24*60*60);
+                const int128_t rate2 = (100000000000000 + rate1) * reserve.last_variable_borrow_cumulative_index / row.last_variable_borrow_cumulative_index;
+                const int128_t total_amount = row.principal_borrow_balance.amount * rate2 / 100000000000000;
+                const extended_asset ext_total = { static_cast<int64_t>(total_amount), { row.principal_borrow_balance.symbol, reserve.contract } };
+                const int128_t value = get_value(ext_total, reserve.oracle_price_id);
+                pos.loans.push_back({ ext_total, reserve.id, value, value });
+                pos.loan_value += value;
+            }
+
+            pos.health_factor = pos.loan_value == 0 ? 0 : mul(pos.ratioed_value, HEALTH_PRECISION) / pos.loan_value;
+            return pos;
+        }
+
+        /**
+         * Same payout as `defilend::get_liquidation_out` from an evaluated position:
+         * Payout = (In * Oracle_last_price_Loan) * (1 + Liquidation_bonus_col) / Oracle_last_price_Col
+         */
+        extended_asset get_liquidation_out( const Position& pos, const extended_asset& ext_in, const extended_symbol& ext_sym_out ) {
+            const PositionAsset* loan = nullptr;
+            const PositionAsset* coll = nullptr;
+            for(const auto& row: pos.loans) if(row.tokens.get_extended_symbol() == ext_in.get_extended_symbol()) loan = &row;
+            for(const auto& row: pos.collaterals) if(row.tokens.get_extended_symbol() == ext_sym_out) coll = &row;
+            if(loan == nullptr || loan->tokens < ext_in || coll == nullptr) return { 0, ext_sym_out };
+
+            const auto& loan_res = get_reserve(loan->reserve_id);
+            const auto& coll_res = get_reserve(coll->reserve_id);
+
+            // oracle id 0 is USDT, priced at 1
+            int128_t loan_price = 1, loan_scale = 1, coll_price = 1, coll_scale = 1;
+            if(loan_res.oracle_price_id){
+                const auto& row = get_price(loan_res.oracle_price_id);
+                loan_price = row.last_price;
+                loan_scale = pow10(row.precision);
+            }
+            if(coll_res.oracle_price_id){
+                const auto& row = get_price(coll_res.oracle_price_id);
+                coll_price = row.last_price;
+                coll_scale = pow10(row.precision);
+            }
+            if(coll_price == 0) return { 0, ext_sym_out };
+
+            const int128_t usd_value = mul(mul(ext_in.quantity.amount, loan_price), VALUE_PRECISION) / mul(pow10(ext_in.quantity.symbol.precision()), loan_scale);
+            const int128_t usd_out = mul(usd_value, 10000 + coll_res.liquidation_bonus) / 10000;
+            const int128_t out = mul(mul(usd_out, coll_scale), pow10(ext_sym_out.get_symbol().precision())) / mul(coll_price, VALUE_PRECISION);
+
+            if(mul(usd_value, 100) > mul(49, pos.loan_value)) return { 0, ext_sym_out };   //only 1/2 of loans allowed to liquidate, take 0.49 to be on the safe side
+            if(coll->tokens.quantity.amount < out) return { 0, ext_sym_out };   //can't get more than collateral
+
+            return { static_cast<int64_t>(out), ext_sym_out };
+        }
+    };
+
+    // evaluator rows in the double form of the helpers below, values are USDT amounts
+    static vector<OraclizedAsset> to_oraclized( const vector<PositionAsset>& assets )
+    {
+        vector<OraclizedAsset> res;
+        for(const auto& row: assets) {
+            res.push_back({ row.tokens, static_cast<double>(row.value) / VALUE_PRECISION, static_cast<double>(row.ratioed) / VALUE_PRECISION });
+        }
+        return res;
+    }
+
     /**
      * ## STATIC `get_collaterals`
      *
@@ -311,24 +565,8 @@ namespace defilend {
      */
     static vector<OraclizedAsset> get_collaterals( const name account )
     {
-        vector<OraclizedAsset> res;
-        reserves reserves_tbl( code, code.value);
-        userconfigs configs_tbl(code, account.value);
-        for(const auto& row: configs_tbl) {
-            if(!row.use_as_collateral) continue;
-            const auto reserve = reserves_tbl.get(row.reserve_id, "defilend: no collateral reserve");
-            const auto bdeposit = utils::get_balance({ reserve.bsym, token_code }, account ).quantity;
-            if(bdeposit.amount == 0) continue;
-            const auto supply = utils::get_supply({ reserve.bsym, token_code });
-            const auto tokens_amount = static_cast<int128_t>(reserve.practical_balance.amount) * bdeposit.amount / supply.amount;
-            const auto tokens = asset{ static_cast<int64_t>(tokens_amount), reserve.practical_balance.symbol };
-            const extended_asset ext_tokens = { tokens, reserve.contract };
-            if( tokens.amount == 0) continue;
-            const auto value = get_value(ext_tokens, reserve.oracle_price_id);
-            res.push_back({ ext_tokens, value, value * reserve.liquidation_threshold / 10000 });
-        }
-
-        return res;
+        evaluator eval;
+        return to_oraclized(eval.evaluate(account).collaterals);
     }
 
     /**
@@ -353,26 +591,10 @@ namespace defilend {
      */
     static vector<OraclizedAsset> get_loans( const name account )
     {
-        vector<OraclizedAsset> res;
-        reserves reserves_tbl( code, code.value);
-        userreserves userreserves_tbl(code, account.value);
-        const auto now = eosio::current_time_point().sec_since_epoch();
-        for(const auto& row: userreserves_tbl) {
-            const auto reserve = reserves_tbl.get(row.reserve_id, "defilend: no loan reserve");
-            const int128_t secs = now - reserve.last_update_time.sec_since_epoch();
-            const int128_t rate1 = reserve.current_variable_borrow_rate * secs / (365*24*60*60);
-            const int128_t rate2 = (100000000000000 + rate1) * reserve.last_variable_borrow_cumulative_index / row.last_variable_borrow_cumulative_index;
-            const int128_t total_amount = row.principal_borrow_balance.amount * rate2 / 100000000000000;
-            // print("\nPrincipal: ", row.principal_borrow_balance, ", Seconds: ", secs, ", Rate1: ", rate1, ", Rate2: ", rate2, ", total_amount: ", total_amount);
-            const extended_asset ext_total = { asset(static_cast<int64_t>(total_amount), row.principal_borrow_balance.symbol), reserve.contract };
-            const auto value = get_value(ext_total, reserve.oracle_price_id);
-            res.push_back({ ext_total, value, value });
-        }
-
-        return res;
+        evaluator eval;
+        return to_oraclized(eval.evaluate(account).loans);
     }
 
-
     /**
      * ## STATIC `get_health_factor`
      *
@@ -408,7 +630,6 @@ namespace defilend {
         return loaned == 0 ? 0 : deposited / loaned;
     }
 
-
     /**
      * ## STATIC `get_health_factor`
      *
@@ -431,90 +652,9 @@ namespace defilend {
      */
     static double get_health_factor( const name account )
     {
-        const auto collaterals = defilend::get_collaterals(account);
-        const auto loans = defilend::get_loans(account);
-
-        return get_health_factor(loans, collaterals);
-    }
-
-    /**
-     * ## STATIC `get_liquidation_out`
-     *
-     * Calculate collateral tokens to receive when liquidating {ext_in} debt
-     * Payout = (In * Oracle_last_price_Loan) * (1 + Liquidation_bonus_col) / Oracle_last_price_Col
-     *
-     * ### params
-     *
-     * - `{extended_asset} ext_in` - amount of debt to liquidate
-     * - `{extended_symbol} ext_sym_out` - desired collateral to receive
-     * - `{vector<OraclizedAsset>} loans` - loans
-     * - `{vector<OraclizedAsset>} collaterals` - collaterals
-     *
-     * ### example
-     *
-     * ```c++
-     * // Inputs
-     * const extended_asset ext_in = { "400 USDT@tethertether" };
-     * const extended_symbol ext_sym_out = { "4,EOS@eosio.token" };
-     * const vector<OraclizedAsset> loans = { {"400 USDT", 400, 400}, {"100 EOS", 500, 500} };
-     * const vector<OraclizedAsset> collaterals = { {"500 USDT", 700, 300}, {"200 EOS", 600, 375} };
-     *
-     * // Calculation
-     * const auto out = defilend::get_liquidation_out( ext_in, ext_sym_out, loans, collaterals );
-     * // => 100 EOS
-     * ```
-     */
-    static extended_asset get_liquidation_out( const extended_asset ext_in, const extended_symbol ext_sym_out, const vector<OraclizedAsset>& loans, const vector<OraclizedAsset>& collaterals )
-    {
-        // no need to check health factor - should check before calling this function
-        // const auto hf = get_health_factor(loans, collaterals);
-        // if(hf >= 1) return { 0, ext_sym_out };
-
-        double loans_value = 0;
-        extended_asset loan_to_liquidate, coll_to_get;
-        for(const auto loan: loans){
-            if(loan.tokens.get_extended_symbol() == ext_in.get_extended_symbol() ) loan_to_liquidate = loan.tokens;
-            loans_value += loan.value;
-        }
-        for(const auto coll: collaterals){
-            if(coll.tokens.get_extended_symbol() == ext_sym_out ) coll_to_get = coll.tokens;
-        }
-        if(loan_to_liquidate.quantity.amount == 0 || loan_to_liquidate < ext_in || coll_to_get.quantity.amount == 0)
-            return { 0, ext_sym_out };
-
-        // TODO: figure out secondary index to get reserve by extended_symbol
-        // reserves reserves_tbl( code, code.value);
-        // auto index = reserves_tbl.get_index<"byextsym"_n>();
-        // auto it = index.lower_bound(static_cast<uint128_t>(ext_in.contract.value) << 64 | (uint64_t) ext_in.quantity.symbol.code().to_string().length() << 48 | ext_in.quantity.symbol.code().raw());
-        // const auto loan_res = *it;
-        const auto& loan_res = get_reserve(ext_in.get_extended_symbol());
-        check(loan_res.sym == ext_in.quantity.symbol, "sx.defilend::get_liquidation_out: Loan not a reserve: " + ext_in.quantity.symbol.code().to_string() + "@" + ext_in.contract.to_string());
-
-        const auto& coll_res = get_reserve(ext_sym_out);
-        check(coll_res.sym == ext_sym_out.get_symbol(), "sx.defilend::get_liquidation_out: Collateral not a reserve: " + ext_sym_out.get_symbol().code().to_string() + "@" + ext_sym_out.get_contract().to_string());
-
-        prices prices_tbl( oracle_code, oracle_code.value);
-        double loan_price = 1, coll_price = 1;
-        if(loan_res.oracle_price_id){   // 0 == USDT
-            const auto row = prices_tbl.get(loan_res.oracle_price_id, "defilend::get_liquidation_out: no loan oracle");
-            loan_price = row.last_price / pow(10, row.precision);
-        }
-        if(coll_res.oracle_price_id){   // 0 == USDT
-            const auto row = prices_tbl.get(coll_res.oracle_price_id, "defilend::get_liquidation_out: no coll oracle");
-            coll_price = row.last_price / pow(10, row.precision);
-        }
-
-        // Payout = (In * Oracle_last_price_Loan) * (1 + Liquidation_bonus_col) / Oracle_last_price_Col
-        const auto usd_value = ext_in.quantity.amount / pow(10, ext_in.quantity.symbol.precision()) * loan_price;
-        const auto usd_out = usd_value * (1 + static_cast<double>(coll_res.liquidation_bonus) / 10000);
-        const int64_t out = usd_out / coll_price * pow(10, ext_sym_out.get_symbol().precision());
-
-        // print("\n  In: ", ext_in.quantity, " loan_price: ", loan_price, " coll_price: ", coll_price, " usd_value: ", usd_value, " usd_out: ", usd_out, " out: ", out);
-        if(usd_value > 0.49 * loans_value) return { 0, ext_sym_out };   //only 1/2 of loans allowed to liquidate, take 0.49 to be on the safe side
-        if(coll_to_get.quantity.amount < out) return { 0, ext_sym_out };   //can't get more than collateral
-
-        return { out, ext_sym_out };
-
+        evaluator eval;
+        const auto pos = eval.evaluate(account);
+        return get_health_factor(to_oraclized(pos.loans), to_oraclized(pos.collaterals));
     }
 
 }
\ No newline at end of file
@@ -3,9 +3,11 @@
 #include <eosio/eosio.hpp>
 #include <eosio/system.hpp>
 #include <eosio/singleton.hpp>
+#include <eosio/binary_extension.hpp>
 #include <math.h>
 #include <string>
 #include <utils.hpp>
+#include <farmmath.hpp>
 
 using namespace std;
 using namespace eosio;
@@ -18,21 +20,51 @@ public:
   
   static constexpr name POOL_MANAGER = name("wdogdeployer");
   static constexpr name SWAP_CONTRACT = name("eosaidaoswat");
+  static constexpr name LPTOKEN_CONTRACT = name("swaplptokent");
   static constexpr name REWARD_CONTRACT = name("aiaidaotoken");
   static constexpr symbol REWARD_SYMBOL = symbol("WDOGE", 3);
   static constexpr uint64_t POW_NUM = 1000;
+  static constexpr uint64_t DEFAULT_EPOCH_LENGTH = 86400;
+  static constexpr uint64_t MAX_BONUS_SLOTS = 4;
+  static constexpr uint128_t BONUS_PRECISION = farmmath::BONUS_PRECISION;
 
   ACTION init(uint64_t reward_per_second);
   ACTION add(uint64_t pid, extended_symbol want, uint64_t weight, bool display);
   ACTION setrewardper(uint64_t reward_per_second);
+  ACTION setepoch(uint64_t epoch_length);
+  ACTION setthreshold(uint64_t payout_threshold);
+  ACTION setkeeper(name keeper);
+  ACTION setbonus(uint64_t pid, extended_symbol token, uint64_t per_second);
   ACTION setweight(uint64_t pid, uint64_t weight);
   ACTION setdisplay(uint64_t pid, bool display);
   ACTION setenabled(uint64_t pid, bool enabled);
   // ACTION deposit(uint64_t pid, name owner, asset quantity);
   // ACTION withdraw(uint64_t pid, name owner, asset quantity);
   ACTION claim(uint64_t pid, name owner);
+  ACTION claimall(name owner, vector<uint64_t> pids);
   ACTION clearuser(uint64_t pid, name owner);
   ACTION rmpool(uint64_t pid);
+  ACTION sweepusers(uint64_t pid, uint64_t epoch, uint64_t limit);
+  ACTION openvault(uint64_t pid, extended_symbol token0, extended_symbol token1, string earn_to_token0_path, string earn_to_token1_path);
+  ACTION vaultexit(name owner, uint64_t pid, uint64_t shares);
+  ACTION compound(uint64_t pid, uint64_t min_return0, uint64_t min_return1);
+  ACTION compoundadd(uint64_t pid, uint64_t kept0, uint64_t kept1);
+
+  struct pool_view {
+    uint64_t pid;
+    extended_symbol want;
+    uint64_t weight;
+    bool enabled;
+    asset total_staked;
+    uint64_t reward_per_share;
+    asset reward_per_second;
+    asset reward_per_year;
+    uint64_t total_weight;
+  };
+
+  [[eosio::action]] asset pending(uint64_t pid, name owner);
+  [[eosio::action]] asset emission(uint64_t pid);
+  [[eosio::action]] pool_view poolinfo(uint64_t pid);
 
   [[eosio::on_notify("*::tokenchange")]]
   void onlptokenchange(symbol_code code, uint64_t pid, name owner, uint64_t pre_amount, uint64_t now_amount);
@@ -43,6 +75,9 @@ public:
   // [[eosio::on_notify("*::logwithdraw")]]
   // void on_withdraw(uint64_t pid, name owner, asset sub_quantity, asset current_balance);
 
+  [[eosio::on_notify("swaplptokent::transfer")]]
+  void on_lptransfer(name from, name to, asset quantity, std::string memo);
+
   // [[eosio::on_notify("*::transfer")]]
   // void on_transfer(name from, name to, asset quantity, std::string memo);
   // void on_deposit(name from, name to, asset quantity, std::string memo);
@@ -51,6 +86,13 @@ public:
   // void logwithdraw(uint64_t pid, name owner, asset want_amt, int128_t shares_removed);
 
 private:
+  // co-incentive emitted by a pool next to WDOGE, slots are never removed so user debts stay aligned
+  struct bonus_slot {
+    extended_symbol token;
+    uint64_t per_second;
+    uint128_t acc_per_share;
+  };
+
   TABLE user_t {
     name owner;
     asset staked;
@@ -60,6 +102,9 @@ private:
     asset amount1;
     uint64_t last_staked_time;
     uint64_t last_withdraw_time;
+    binary_extension<uint64_t> unclaimed;
+    binary_extension<vector<uint128_t>> bonus_debt;
+    binary_extension<vector<uint64_t>> bonus_unclaimed;
 
     uint64_t primary_key() const { return owner.value; }
   }; 
@@ -75,22 +120,120 @@ private:
     asset total_staked;  
     bool display;
     bool enabled;
+    binary_extension<uint128_t> reward_per_weight_paid;
+    binary_extension<uint64_t> epoch;
+    binary_extension<vector<bonus_slot>> bonuses;
     
     uint64_t primary_key() const { return pid; }
   };
 
+  // compounding vault of a pool, its LP is held by the farm account and farmed as any holder
+  TABLE vault_t {
+    uint64_t pid;
+    extended_symbol token0;
+    extended_symbol token1;
+    string earn_to_token0_path;
+    string earn_to_token1_path;
+    uint64_t shares_total;
+    uint64_t token0_before;
+    uint64_t token1_before;
+    uint64_t last_compound_time;
+
+    uint64_t primary_key() const { return pid; }
+  };
+
+  // vault shares of an owner, scoped by pid
+  TABLE vault_user_t {
+    name owner;
+    uint64_t shares;
+
+    uint64_t primary_key() const { return owner.value; }
+  };
+
+  // epoch the next listing of a removed pid starts at
+  TABLE epoch_t {
+    uint64_t pid;
+    uint64_t epoch;
+
+    uint64_t primary_key() const { return pid; }
+  };
+
+  // final reward and bonus indexes of a removed listing, keyed by its `users` scope, so `sweepusers`
+  // can pay the rewards its rows still hold
+  TABLE retired_t {
+    uint64_t scope;
+    uint64_t reward_per_share;
+    binary_extension<vector<bonus_slot>> bonuses;
+
+    uint64_t primary_key() const { return scope; }
+  };
+
+  // pools an owner has a `users` row in, scoped by owner
+  TABLE stake_t {
+    uint64_t pid;
+
+    uint64_t primary_key() const { return pid; }
+  };
+
   struct [[eosio::table]] global_t {
       uint64_t reward_per_second;
+      // rewards accrued by LP changes are paid once `unclaimed` reaches it
+      binary_extension<uint64_t> payout_threshold;
+      // account allowed to run `compound`, the pool manager when unset
+      binary_extension<name> keeper;
   }; 
 
+  // rewards accrued per unit of pool weight since the index started, pools settle against it lazily
+  struct [[eosio::table]] reward_index_t {
+      uint128_t reward_per_weight;
+      uint64_t total_weight;
+      uint64_t last_update_time;
+  };
+
+  // rewards minted ahead for one epoch of emission, pools draw from `balance`
+  struct [[eosio::table]] budget_t {
+      uint64_t epoch_length;
+      uint64_t balance;
+      uint64_t last_mint_time;
+  };
+
   typedef eosio::singleton<"globals"_n, global_t> globals;
   typedef multi_index<name("globals"), global_t> globals_for_abi;
+  typedef eosio::singleton<"rewardindex"_n, reward_index_t> rewardindex;
+  typedef multi_index<name("rewardindex"), reward_index_t> rewardindex_for_abi;
+  typedef eosio::singleton<"budgets"_n, budget_t> budgets;
+  typedef multi_index<name("budgets"), budget_t> budgets_for_abi;
   typedef multi_index<"users"_n, user_t> users;
   typedef multi_index<"pools"_n, pool_t> pools;
+  typedef multi_index<"stakes"_n, stake_t> stakes;
+  typedef multi_index<"epochs"_n, epoch_t> epochs;
+  typedef multi_index<"retired"_n, retired_t> retireds;
+  typedef multi_index<"vaults"_n, vault_t> vaults;
+  typedef multi_index<"vaultusers"_n, vault_user_t> vaultusers;
 
   pools _pools = pools(_self, _self.value);
   globals _globals = globals(_self, _self.value);
+  rewardindex _rewardindex = rewardindex(_self, _self.value);
+  budgets _budgets = budgets(_self, _self.value);
+  epochs _epochs = epochs(_self, _self.value);
+  retireds _retireds = retireds(_self, _self.value);
+  vaults _vaults = vaults(_self, _self.value);
+
+  // `users` scope of a pool listing, epoch 0 keeps the plain pid scope of pools listed before epochs
+  static uint64_t user_scope(uint64_t pid, uint64_t epoch) {
+    return (epoch << 48) | pid;
+  }
 
-  void update_all_pools();
+  reward_index_t projected_index();
+  reward_index_t update_index();
+  uint64_t accrued_reward(const pool_t &pool, uint128_t reward_per_weight);
   void update_pool(uint64_t pid);
+  void draw_budget(uint64_t reward);
+  uint64_t harvest(uint64_t pid, name owner, vector<extended_asset> &bonuses);
+  void accrue_bonuses(const vector<bonus_slot> &slots, user_t &user, uint64_t now_shares);
+  void take_bonuses(const vector<bonus_slot> &slots, user_t &user, vector<extended_asset> &bonuses);
+  void pay_bonuses(name owner, const vector<extended_asset> &bonuses);
+  bool has_bonuses(const user_t &user);
+  uint64_t current_epoch(uint64_t pid);
+  void settle_change(uint64_t pid, name owner, uint64_t pre_amount, uint64_t now_amount);
 };
@@ -0,0 +1,82 @@
+#pragma once
+#include <cstdint>
+
+// reward arithmetic shared by the farm contract and the host replay engine in `farm/replay`,
+// keep it free of eosio dependencies so both compile it unchanged
+namespace farmmath {
+    using u128 = unsigned __int128;
+
+    // reward per unit of weight accrued between `last_time` and `now_time`
+    inline u128 advance_index( const u128 reward_per_weight, const uint64_t last_time, const uint64_t now_time, const uint64_t reward_per_second ) {
+        if (now_time <= last_time) return reward_per_weight;
+        return reward_per_weight + static_cast<u128>(now_time - last_time) * reward_per_second;
+    }
+
+    // largest reward a pool may settle in one step, the max amount of an eosio asset
+    constexpr u128 MAX_REWARD = (static_cast<uint64_t>(1) << 62) - 1;
+
+    // reward of a pool since it settled at `paid`, disabled or empty pools skip the period;
+    // unnarrowed, callers check it against `MAX_REWARD` before they settle it
+    inline u128 pool_reward( const u128 reward_per_weight, const u128 paid, const uint64_t weight, const bool enabled, const uint64_t shares_total ) {
+        if (!enabled || shares_total == 0) return 0;
+        return (reward_per_weight - paid) * weight;
+    }
+
+    inline uint64_t reward_per_share_step( const uint64_t reward, const uint64_t shares_total ) {
+        return reward / shares_total;
+    }
+
+    // wraps like the contract's uint64 arithmetic
+    inline uint64_t user_pending( const uint64_t shares, const uint64_t reward_per_share, const uint64_t reward_debt ) {
+        return shares * reward_per_share - reward_debt;
+    }
+
+    // index a pool listed before the global index accrues on its first settlement, the time
+    // since `last_time` at the current rate
+    inline u128 legacy_accrual( const uint64_t last_time, const uint64_t now_time, const uint64_t reward_per_second ) {
+        return now_time > last_time ? static_cast<u128>(now_time - last_time) * reward_per_second : 0;
+    }
+
+    // amount to mint when the epoch budget cannot cover `reward`: one epoch of emission at the
+    // current rate and weight, or the shortfall when that is less; 0 when the budget suffices
+    inline u128 budget_mint( const uint64_t balance, const uint64_t reward, const uint64_t reward_per_second, const uint64_t total_weight, const uint64_t epoch_length ) {
+        if (balance >= reward) return 0;
+        const u128 amount = static_cast<u128>(reward_per_second) * total_weight * epoch_length;
+        return amount < reward - balance ? reward - balance : amount;
+    }
+
+    // an emptied pool restarts its share index, for the contract's `pool_t` and the replay's pool alike
+    template <typename Pool>
+    inline void reset_if_empty( Pool &pool, const uint64_t now_time ) {
+        if (pool.shares_total != 0) return;
+        pool.reward_per_share = 0;
+        pool.total_rewards = 0;
+        pool.last_reward_time = now_time;
+    }
+
+    struct settlement {
+        uint64_t payout;
+        uint64_t unclaimed;
+    };
+
+    // rewards of a position whose LP balance changes to `now_amount`: paid when the position closes
+    // or once they reach `threshold`, held otherwise; the farm's own position (vault LP) always holds
+    // them for `compound`
+    inline settlement settle_rewards( const uint64_t shares, const uint64_t reward_per_share, const uint64_t reward_debt, const uint64_t unclaimed,
+                                      const uint64_t now_amount, const uint64_t threshold, const bool is_farm ) {
+        const uint64_t total = unclaimed + user_pending(shares, reward_per_share, reward_debt);
+        if (!is_farm && (now_amount == 0 || total >= threshold)) return { total, 0 };
+        return { 0, total };
+    }
+
+    // bonus slots accrue per share at `BONUS_PRECISION`
+    constexpr u128 BONUS_PRECISION = 1000000000000;
+
+    inline u128 bonus_step( const uint64_t elapsed, const uint64_t per_second, const uint64_t shares_total ) {
+        return static_cast<u128>(elapsed) * per_second * BONUS_PRECISION / shares_total;
+    }
+
+    inline u128 bonus_debt( const uint64_t shares, const u128 acc_per_share ) {
+        return static_cast<u128>(shares) * acc_per_share / BONUS_PRECISION;
+    }
+}
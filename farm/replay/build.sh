@@ -0,0 +1,13 @@
+#!/bin/bash
+set -e
+cd "$(dirname "$0")"
+
+g++ -std=c++17 -O2 -I ../include -o replay replay.cpp
+g++ -std=c++17 -O2 -I ../include -o earn_plan earn_plan.cpp
+
+# the fixture replays to its hand-worked ledger and on-chain rows, any drift in `farmmath.hpp` or the engine shows up here
+./replay fixtures/events.txt fixtures/users.txt > fixtures/actual.txt
+diff -u fixtures/expected.txt fixtures/actual.txt
+rm fixtures/actual.txt
+
+./earn_plan
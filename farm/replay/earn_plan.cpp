@@ -0,0 +1,75 @@
+// host checks for the boxlp earn schedule (`boxlpmath.hpp`)
+//
+// usage: earn_plan, exits non-zero on the first failed case
+
+#include <boxlpmath.hpp>
+
+#include <cstdio>
+#include <cstdlib>
+
+namespace {
+
+    int failures = 0;
+
+    void expect( bool ok, const char *name ) {
+        if (ok) return;
+        std::fprintf(stderr, "earn_plan: %s failed\n", name);
+        failures++;
+    }
+
+    boxlpmath::earn_state locked_state() {
+        boxlpmath::earn_state s {};
+        s.now_time = 1700003600;
+        s.last_earn_time = 1700000000;
+        s.duration = 3600;
+        s.max_delay = 8;
+        s.locked = true;
+        s.queued = true;
+        s.farmed = true;
+        return s;
+    }
+}
+
+int main() {
+    // locked want without a crab farm row: no claim, the queue still settles
+    {
+        boxlpmath::earn_state s = locked_state();
+        s.farmed = false;
+        const auto plan = boxlpmath::plan_earn(s);
+        expect(!plan.harvest && plan.settle && !plan.reschedule, "locked want without a farm row");
+    }
+    // locked want with a farm row and no gate: harvest, the queue settles after it
+    {
+        const auto plan = boxlpmath::plan_earn(locked_state());
+        expect(plan.harvest && !plan.settle, "locked want with a farm row");
+    }
+    // projected harvest below `min_earn`: rescheduled, the queue still settles
+    {
+        boxlpmath::earn_state s = locked_state();
+        s.min_earn = 1000;
+        s.last_earned = 100;
+        s.last_earn_span = 3600;
+        const auto plan = boxlpmath::plan_earn(s);
+        expect(!plan.harvest && plan.settle && plan.reschedule, "gated harvest");
+        expect(plan.next_earn_time == s.last_earn_time + 8 * s.duration, "gated harvest waits at most max_delay durations");
+    }
+    // projected harvest at `min_earn`: harvest
+    {
+        boxlpmath::earn_state s = locked_state();
+        s.min_earn = 100;
+        s.last_earned = 100;
+        s.last_earn_span = 3600;
+        expect(boxlpmath::plan_earn(s).harvest, "harvest at min_earn");
+    }
+    // nothing locked yet: the first deposits settle
+    {
+        boxlpmath::earn_state s = locked_state();
+        s.locked = false;
+        const auto plan = boxlpmath::plan_earn(s);
+        expect(!plan.harvest && plan.settle, "first deposits");
+    }
+
+    if (failures > 0) return 1;
+    std::fprintf(stderr, "earn_plan: ok\n");
+    return 0;
+}
@@ -0,0 +1,640 @@
+// host replay engine for farm accounting
+//
+// replays a recorded event stream through the same arithmetic and settlement rules as the contract
+// (`farmmath.hpp`) and prints the resulting ledger, optionally diffed against a dump of on-chain `users` rows
+//
+// usage: replay <events> [onchain users]
+//
+// events, one per line, `#` starts a comment, a token is `<precision>,<SYMBOL>@<contract>`:
+//   <time> init <reward_per_second>
+//   <time> setrewardper <reward_per_second>
+//   <time> setthreshold <payout_threshold>
+//   <time> setepoch <epoch_length>
+//   <time> add <pid> <weight>
+//   <time> legacy <pid> <weight>                   pool listed before the global index
+//   <time> snapshot <pid> <owner> <shares> <reward_debt>   row already on chain when the recording starts
+//   <time> setweight <pid> <weight>
+//   <time> setenabled <pid> <0|1>
+//   <time> setbonus <pid> <token> <per_second>
+//   <time> fund <token> <amount>                   bonus tokens received by the farm account
+//   <time> rmpool <pid>
+//   <time> sweepusers <pid> <epoch> <limit>
+//   <time> tokenchange <pid> <owner> <pre_amount> <now_amount>
+//   <time> claim <pid> <owner>
+//   <time> compound <pid>                          harvest of the farm account's vault position
+//
+// onchain users, one per line: <pid> <epoch> <owner> <shares> <reward_debt> <unclaimed>
+//
+// output, sorted so runs can be diffed:
+//   user <pid> <epoch> <owner> <shares> <reward_debt> <unclaimed> <bonus_unclaimed,...|->
+//   retired <pid> <epoch> <reward_per_share>
+//   paid <owner> <reward paid>
+//   bonus <owner> <token> <amount paid>
+//   totals minted <minted> budget <budget balance> paid <paid> compounded <compounded>
+//   then `diff` lines against the on-chain dump
+//
+// `fixtures/` holds a stream with its expected output, `build.sh` replays and diffs it
+
+#include <farmmath.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+    const std::string_view FARM_ACCOUNT = "swapswapfarm";
+    const std::string_view REWARD_TOKEN = "3,WDOGE@aiaidaotoken";
+    const std::string_view LPTOKEN_CONTRACT = "@swaplptokent";
+    constexpr uint64_t DEFAULT_EPOCH_LENGTH = 86400;
+
+    [[noreturn]] void fail( const std::string &message ) {
+        std::fprintf(stderr, "replay: %s\n", message.c_str());
+        std::exit(1);
+    }
+
+    // eosio `name` value, so rows iterate in the contract's primary key order
+    uint64_t name_value( std::string_view str ) {
+        if (str.size() > 13) fail("invalid name " + std::string(str));
+        uint64_t value = 0;
+        for (size_t i = 0; i < 13; i++) {
+            uint64_t c = 0;
+            if (i < str.size()) {
+                const char ch = str[i];
+                if (ch >= 'a' && ch <= 'z') c = ch - 'a' + 6;
+                else if (ch >= '1' && ch <= '5') c = ch - '1' + 1;
+                else if (ch != '.') fail("invalid name " + std::string(str));
+            }
+            value |= i < 12 ? (c & 0x1f) << (64 - 5 * (i + 1)) : c & 0x0f;
+        }
+        return value;
+    }
+
+    struct bonus_slot {
+        std::string token;
+        uint64_t per_second = 0;
+        farmmath::u128 acc_per_share = 0;
+    };
+
+    struct pool_state {
+        uint64_t weight = 0;
+        bool enabled = true;
+        uint64_t last_reward_time = 0;
+        uint64_t reward_per_share = 0;
+        uint64_t total_rewards = 0;
+        uint64_t shares_total = 0;
+        bool has_paid = false;
+        farmmath::u128 reward_per_weight_paid = 0;
+        uint64_t epoch = 0;
+        std::vector<bonus_slot> bonuses;
+    };
+
+    struct user_state {
+        std::string owner;
+        uint64_t shares = 0;
+        uint64_t reward_debt = 0;
+        uint64_t unclaimed = 0;
+        std::vector<farmmath::u128> bonus_debt;
+        std::vector<uint64_t> bonus_unclaimed;
+    };
+
+    struct retired_state {
+        uint64_t reward_per_share = 0;
+        std::vector<bonus_slot> bonuses;
+    };
+
+    // rows of one `users` scope keyed like the contract's primary key
+    using scope_rows = std::map<uint64_t, user_state>;
+
+    class engine {
+    public:
+        void init( uint64_t now, uint64_t reward_per_second ) {
+            update_index(now);
+            _reward_per_second = reward_per_second;
+        }
+
+        void setthreshold( uint64_t threshold ) { _payout_threshold = threshold; }
+
+        void setepoch( uint64_t epoch_length ) {
+            if (epoch_length == 0) fail("epoch length must be positive");
+            _epoch_length = epoch_length;
+        }
+
+        // mirrors `farm::add`
+        void add( uint64_t now, uint64_t pid, uint64_t weight ) {
+            if (_pools.count(pid)) return;
+            const uint64_t epoch = current_epoch(pid);
+            update_index(now);
+            _total_weight += weight;
+            pool_state pool;
+            pool.weight = weight;
+            pool.last_reward_time = now;
+            pool.has_paid = true;
+            pool.reward_per_weight_paid = _reward_per_weight;
+            pool.epoch = epoch;
+            _pools[pid] = pool;
+        }
+
+        // a pool listed before the index: no paid value, not yet in the index weight
+        void legacy( uint64_t now, uint64_t pid, uint64_t weight ) {
+            if (_pools.count(pid)) return;
+            pool_state pool;
+            pool.weight = weight;
+            pool.last_reward_time = now;
+            _pools[pid] = pool;
+        }
+
+        void snapshot( uint64_t pid, const std::string &owner, uint64_t shares, uint64_t reward_debt ) {
+            pool_state &pool = require_pool(pid);
+            user_state user;
+            user.owner = owner;
+            user.shares = shares;
+            user.reward_debt = reward_debt;
+            _users[scope(pid, pool.epoch)][name_value(owner)] = user;
+            pool.shares_total += shares;
+        }
+
+        // mirrors `farm::setweight`
+        void setweight( uint64_t now, uint64_t pid, uint64_t weight ) {
+            update_pool(now, pid);
+            pool_state &pool = require_pool(pid);
+            if (pool.enabled) _total_weight = _total_weight + weight - pool.weight;
+            pool.weight = weight;
+        }
+
+        // mirrors `farm::setenabled`
+        void setenabled( uint64_t now, uint64_t pid, bool enabled ) {
+            update_pool(now, pid);
+            pool_state &pool = require_pool(pid);
+            if (pool.enabled != enabled) _total_weight = enabled ? _total_weight + pool.weight : _total_weight - pool.weight;
+            pool.enabled = enabled;
+            pool.last_reward_time = now;
+        }
+
+        // mirrors `farm::setbonus`
+        void setbonus( uint64_t now, uint64_t pid, const std::string &token, uint64_t per_second ) {
+            if (token == REWARD_TOKEN) fail("bonus token cannot be the reward token");
+            if (token.size() >= LPTOKEN_CONTRACT.size() && token.compare(token.size() - LPTOKEN_CONTRACT.size(), LPTOKEN_CONTRACT.size(), LPTOKEN_CONTRACT) == 0) fail("bonus token cannot be an LP token");
+            update_pool(now, pid);
+            pool_state &pool = require_pool(pid);
+            for (auto &slot : pool.bonuses) {
+                if (slot.token != token) continue;
+                slot.per_second = per_second;
+                return;
+            }
+            if (pool.bonuses.size() >= 4) fail("bonus slots are full");
+            pool.bonuses.push_back(bonus_slot{token, per_second, 0});
+        }
+
+        void fund( const std::string &token, uint64_t amount ) { _balances[token] += amount; }
+
+        // mirrors `farm::rmpool`, the rows stay in the retired scope for `sweepusers`
+        void rmpool( uint64_t now, uint64_t pid ) {
+            update_pool(now, pid);
+            pool_state &pool = require_pool(pid);
+            if (pool.enabled && pool.has_paid) _total_weight -= pool.weight;
+            _retired[scope(pid, pool.epoch)] = retired_state{pool.reward_per_share, pool.bonuses};
+            _epochs[pid] = pool.epoch + 1;
+            _pools.erase(pid);
+        }
+
+        // mirrors `farm::sweepusers`
+        void sweepusers( uint64_t pid, uint64_t epoch, uint64_t limit ) {
+            if (epoch >= current_epoch(pid)) fail("epoch is still active");
+            const uint64_t key = scope(pid, epoch);
+            scope_rows &rows = _users[key];
+            auto retired_itr = _retired.find(key);
+            const std::vector<bonus_slot> slots = retired_itr == _retired.end() ? std::vector<bonus_slot>{} : retired_itr->second.bonuses;
+            for (auto itr = rows.begin(); itr != rows.end() && limit > 0; limit--) {
+                user_state &user = itr->second;
+                uint64_t pending = user.unclaimed;
+                if (retired_itr != _retired.end()) pending += farmmath::user_pending(user.shares, retired_itr->second.reward_per_share, user.reward_debt);
+                if (user.owner != FARM_ACCOUNT && pending > 0) pay(user.owner, pending);
+
+                accrue_bonuses(slots, user, 0);
+                take_bonuses(slots, user);
+                if (has_bonuses(user)) {
+                    user.shares = 0;
+                    user.reward_debt = 0;
+                    user.unclaimed = 0;
+                    itr++;
+                    continue;
+                }
+                itr = rows.erase(itr);
+            }
+            if (rows.empty() && retired_itr != _retired.end()) _retired.erase(retired_itr);
+        }
+
+        // mirrors `farm::settle_change`
+        void tokenchange( uint64_t now, uint64_t pid, const std::string &owner, uint64_t pre_amount, uint64_t now_amount ) {
+            if (pre_amount == now_amount) return;
+            update_pool(now, pid);
+            auto pool_itr = _pools.find(pid);
+            if (pool_itr == _pools.end() || !pool_itr->second.enabled) return;
+            pool_state &pool = pool_itr->second;
+
+            scope_rows &rows = _users[scope(pid, pool.epoch)];
+            auto user_itr = rows.find(name_value(owner));
+            // the contract's direction test wraps in uint64, only an unchanged balance reads as a withdrawal
+            const bool deposit = (now_amount - pre_amount) > 0;
+            if (!deposit && user_itr == rows.end()) return;
+
+            farmmath::reset_if_empty(pool, now);
+            if (user_itr == rows.end()) {
+                user_state user;
+                user.owner = owner;
+                accrue_bonuses(pool.bonuses, user, now_amount);
+                user.shares = now_amount;
+                user.reward_debt = now_amount * pool.reward_per_share;
+                rows[name_value(owner)] = user;
+                pool.shares_total += now_amount;
+                return;
+            }
+            pool.shares_total += now_amount - pre_amount;
+
+            user_state &user = user_itr->second;
+            const farmmath::settlement settled = farmmath::settle_rewards(user.shares, pool.reward_per_share, user.reward_debt, user.unclaimed,
+                now_amount, _payout_threshold, owner == FARM_ACCOUNT);
+            accrue_bonuses(pool.bonuses, user, now_amount);
+            if (now_amount == 0 && !has_bonuses(user)) {
+                rows.erase(user_itr);
+            } else {
+                user.shares = now_amount;
+                user.reward_debt = now_amount * pool.reward_per_share;
+                user.unclaimed = settled.unclaimed;
+            }
+
+            farmmath::reset_if_empty(pool, now);
+            if (settled.payout > 0) pay(owner, settled.payout);
+        }
+
+        // mirrors `farm::claim`, the farm account never claims
+        void claim( uint64_t now, uint64_t pid, const std::string &owner ) {
+            if (owner == FARM_ACCOUNT) fail("the farm account does not claim, use compound");
+            if (!_pools.count(pid)) fail("not fund pid");
+            if (find_user(pid, _pools[pid].epoch, owner) == nullptr) fail("not fund user " + owner);
+            const uint64_t pending = harvest(now, pid, owner);
+            if (pending > 0) pay(owner, pending);
+        }
+
+        // mirrors the harvest of `farm::compound`, its reward is swapped and added back as LP
+        void compound( uint64_t now, uint64_t pid ) {
+            _compounded += harvest(now, pid, std::string(FARM_ACCOUNT));
+        }
+
+        void print() const {
+            for (const auto &[key, rows] : _users) {
+                for (const auto &[id, user] : rows) {
+                    std::string bonuses;
+                    for (const uint64_t amount : user.bonus_unclaimed) bonuses += (bonuses.empty() ? "" : ",") + std::to_string(amount);
+                    std::printf("user %llu %llu %s %llu %llu %llu %s\n", ull(key & 0xffffffffffff), ull(key >> 48), user.owner.c_str(),
+                        ull(user.shares), ull(user.reward_debt), ull(user.unclaimed), bonuses.empty() ? "-" : bonuses.c_str());
+                }
+            }
+            for (const auto &[key, retired] : _retired) {
+                std::printf("retired %llu %llu %llu\n", ull(key & 0xffffffffffff), ull(key >> 48), ull(retired.reward_per_share));
+            }
+            for (const auto &[owner, amount] : _paid_by_owner) {
+                std::printf("paid %s %llu\n", owner.c_str(), ull(amount));
+            }
+            for (const auto &[id, amount] : _bonus_paid) {
+                std::printf("bonus %s %s %llu\n", id.first.c_str(), id.second.c_str(), ull(amount));
+            }
+            std::printf("totals minted %llu budget %llu paid %llu compounded %llu\n", ull(_minted), ull(_budget), ull(_paid), ull(_compounded));
+        }
+
+        const user_state *find_user( uint64_t pid, uint64_t epoch, std::string_view owner ) const {
+            auto scope_itr = _users.find(scope(pid, epoch));
+            if (scope_itr == _users.end()) return nullptr;
+            auto user_itr = scope_itr->second.find(name_value(owner));
+            return user_itr == scope_itr->second.end() ? nullptr : &user_itr->second;
+        }
+
+        const std::map<uint64_t, scope_rows> &users() const { return _users; }
+        uint64_t minted() const { return _minted; }
+        uint64_t paid() const { return _paid; }
+
+        static uint64_t scope( uint64_t pid, uint64_t epoch ) { return (epoch << 48) | pid; }
+        static unsigned long long ull( uint64_t value ) { return static_cast<unsigned long long>(value); }
+
+    private:
+        pool_state &require_pool( uint64_t pid ) {
+            auto itr = _pools.find(pid);
+            if (itr == _pools.end()) fail("not fund pid " + std::to_string(pid));
+            return itr->second;
+        }
+
+        uint64_t current_epoch( uint64_t pid ) const {
+            auto pool_itr = _pools.find(pid);
+            if (pool_itr != _pools.end()) return pool_itr->second.epoch;
+            auto epoch_itr = _epochs.find(pid);
+            return epoch_itr == _epochs.end() ? 0 : epoch_itr->second;
+        }
+
+        void update_index( uint64_t now ) {
+            if (!_index_started) {
+                _index_started = true;
+                _last_update_time = now;
+            }
+            _reward_per_weight = farmmath::advance_index(_reward_per_weight, _last_update_time, now, _reward_per_second);
+            if (now > _last_update_time) _last_update_time = now;
+        }
+
+        // mirrors `farm::update_pool`
+        void update_pool( uint64_t now, uint64_t pid ) {
+            auto itr = _pools.find(pid);
+            if (itr == _pools.end()) return;
+            update_index(now);
+            pool_state &pool = itr->second;
+            const farmmath::u128 accrued = pool.has_paid
+                ? farmmath::pool_reward(_reward_per_weight, pool.reward_per_weight_paid, pool.weight, pool.enabled, pool.shares_total)
+                : farmmath::pool_reward(farmmath::legacy_accrual(pool.last_reward_time, now, _reward_per_second), 0, pool.weight, pool.enabled, pool.shares_total);
+            if (accrued > farmmath::MAX_REWARD) fail("reward overflow in pool " + std::to_string(pid));
+            const uint64_t reward = static_cast<uint64_t>(accrued);
+            if (!pool.has_paid && pool.enabled) _total_weight += pool.weight;
+
+            const uint64_t elapsed = now > pool.last_reward_time ? now - pool.last_reward_time : 0;
+            if (reward > 0) {
+                pool.reward_per_share += farmmath::reward_per_share_step(reward, pool.shares_total);
+                pool.total_rewards += reward;
+            }
+            if (pool.enabled && pool.shares_total > 0 && elapsed > 0) {
+                for (auto &slot : pool.bonuses) slot.acc_per_share += farmmath::bonus_step(elapsed, slot.per_second, pool.shares_total);
+            }
+            pool.has_paid = true;
+            pool.reward_per_weight_paid = _reward_per_weight;
+            pool.last_reward_time = now;
+            if (reward > 0) draw_budget(reward);
+        }
+
+        // mirrors `farm::draw_budget`
+        void draw_budget( uint64_t reward ) {
+            const farmmath::u128 amount = farmmath::budget_mint(_budget, reward, _reward_per_second, _total_weight, _epoch_length);
+            if (amount > farmmath::MAX_REWARD) fail("epoch budget overflow");
+            _budget += static_cast<uint64_t>(amount);
+            _minted += static_cast<uint64_t>(amount);
+            _budget -= reward;
+        }
+
+        // mirrors `farm::harvest`
+        uint64_t harvest( uint64_t now, uint64_t pid, const std::string &owner ) {
+            auto pool_itr = _pools.find(pid);
+            if (pool_itr == _pools.end()) return 0;
+            update_pool(now, pid);
+            pool_state &pool = pool_itr->second;
+            scope_rows &rows = _users[scope(pid, pool.epoch)];
+            auto user_itr = rows.find(name_value(owner));
+            if (user_itr == rows.end()) return 0;
+
+            user_state &user = user_itr->second;
+            accrue_bonuses(pool.bonuses, user, user.shares);
+            take_bonuses(pool.bonuses, user);
+            const uint64_t pending = farmmath::user_pending(user.shares, pool.reward_per_share, user.reward_debt) + user.unclaimed;
+            if (user.shares == 0 && !has_bonuses(user)) {
+                rows.erase(user_itr);
+                return pending;
+            }
+            user.reward_debt = user.shares * pool.reward_per_share;
+            user.unclaimed = 0;
+            return pending;
+        }
+
+        // mirrors `farm::accrue_bonuses`
+        static void accrue_bonuses( const std::vector<bonus_slot> &slots, user_state &user, uint64_t now_shares ) {
+            if (slots.empty() || user.owner == FARM_ACCOUNT) return;
+            user.bonus_debt.resize(slots.size(), 0);
+            user.bonus_unclaimed.resize(slots.size(), 0);
+            for (size_t i = 0; i < slots.size(); i++) {
+                const farmmath::u128 earned = farmmath::bonus_debt(user.shares, slots[i].acc_per_share);
+                if (earned > user.bonus_debt[i]) user.bonus_unclaimed[i] += static_cast<uint64_t>(earned - user.bonus_debt[i]);
+                user.bonus_debt[i] = farmmath::bonus_debt(now_shares, slots[i].acc_per_share);
+            }
+        }
+
+        // mirrors `farm::take_bonuses`, capped at the farm's balance of each token and paid at once
+        void take_bonuses( const std::vector<bonus_slot> &slots, user_state &user ) {
+            for (size_t i = 0; i < slots.size() && i < user.bonus_unclaimed.size(); i++) {
+                if (user.bonus_unclaimed[i] == 0) continue;
+                uint64_t &balance = _balances[slots[i].token];
+                const uint64_t amount = std::min(user.bonus_unclaimed[i], balance);
+                if (amount == 0) continue;
+                balance -= amount;
+                user.bonus_unclaimed[i] -= amount;
+                _bonus_paid[{user.owner, slots[i].token}] += amount;
+            }
+        }
+
+        static bool has_bonuses( const user_state &user ) {
+            for (const uint64_t amount : user.bonus_unclaimed) if (amount > 0) return true;
+            return false;
+        }
+
+        void pay( const std::string &owner, uint64_t amount ) {
+            _paid_by_owner[owner] += amount;
+            _paid += amount;
+        }
+
+        uint64_t _reward_per_second = 0;
+        uint64_t _payout_threshold = 0;
+        uint64_t _epoch_length = DEFAULT_EPOCH_LENGTH;
+        bool _index_started = false;
+        uint64_t _last_update_time = 0;
+        farmmath::u128 _reward_per_weight = 0;
+        uint64_t _total_weight = 0;
+        uint64_t _budget = 0;
+        uint64_t _minted = 0;
+        uint64_t _paid = 0;
+        uint64_t _compounded = 0;
+        std::map<uint64_t, pool_state> _pools;
+        std::map<uint64_t, uint64_t> _epochs;
+        std::map<uint64_t, retired_state> _retired;
+        std::map<uint64_t, scope_rows> _users;
+        std::map<std::string, uint64_t> _balances;
+        std::map<std::string, uint64_t> _paid_by_owner;
+        std::map<std::pair<std::string, std::string>, uint64_t> _bonus_paid;
+    };
+
+    // whitespace tokenizer over a whole file, events files are large so no per-line allocations
+    class reader {
+    public:
+        explicit reader( const std::string &data ) : _data(data) {}
+
+        bool next_line() {
+            while (_pos < _data.size()) {
+                skip_blank();
+                if (_pos >= _data.size()) return false;
+                if (_data[_pos] == '\n') { _pos++; continue; }
+                if (_data[_pos] == '#') { skip_line(); continue; }
+                return true;
+            }
+            return false;
+        }
+
+        std::string_view token() {
+            skip_blank();
+            const size_t start = _pos;
+            while (_pos < _data.size() && !is_space(_data[_pos])) _pos++;
+            return std::string_view(_data).substr(start, _pos - start);
+        }
+
+        uint64_t number() {
+            const std::string_view str = token();
+            uint64_t value = 0;
+            for (const char c : str) {
+                if (c < '0' || c > '9') fail(str);
+                value = value * 10 + (c - '0');
+            }
+            if (str.empty()) fail(str);
+            return value;
+        }
+
+        void skip_line() {
+            while (_pos < _data.size() && _data[_pos] != '\n') _pos++;
+        }
+
+        [[noreturn]] void fail( std::string_view str ) const {
+            std::fprintf(stderr, "replay: invalid token `%.*s` at byte %zu\n", static_cast<int>(str.size()), str.data(), _pos);
+            std::exit(1);
+        }
+
+    private:
+        static bool is_space( char c ) { return c == ' ' || c == '\t' || c == '\r' || c == '\n'; }
+        void skip_blank() {
+            while (_pos < _data.size() && (_data[_pos] == ' ' || _data[_pos] == '\t' || _data[_pos] == '\r')) _pos++;
+        }
+
+        const std::string &_data;
+        size_t _pos = 0;
+    };
+
+    std::string read_file( const char *path ) {
+        std::ifstream file(path, std::ios::binary);
+        if (!file) fail(std::string("cannot open ") + path);
+        std::ostringstream buffer;
+        buffer << file.rdbuf();
+        return buffer.str();
+    }
+}
+
+int main( int argc, char **argv ) {
+    if (argc < 2) {
+        std::fprintf(stderr, "usage: %s <events> [onchain users]\n", argv[0]);
+        return 1;
+    }
+
+    const std::string data = read_file(argv[1]);
+    reader in(data);
+    engine farm;
+
+    const auto started = std::chrono::steady_clock::now();
+    uint64_t events = 0;
+    while (in.next_line()) {
+        const uint64_t now = in.number();
+        const std::string_view type = in.token();
+        if (type == "tokenchange") {
+            const uint64_t pid = in.number();
+            const std::string owner(in.token());
+            const uint64_t pre_amount = in.number();
+            const uint64_t now_amount = in.number();
+            farm.tokenchange(now, pid, owner, pre_amount, now_amount);
+        } else if (type == "claim") {
+            const uint64_t pid = in.number();
+            farm.claim(now, pid, std::string(in.token()));
+        } else if (type == "compound") {
+            farm.compound(now, in.number());
+        } else if (type == "init" || type == "setrewardper") {
+            farm.init(now, in.number());
+        } else if (type == "setthreshold") {
+            farm.setthreshold(in.number());
+        } else if (type == "setepoch") {
+            farm.setepoch(in.number());
+        } else if (type == "add") {
+            const uint64_t pid = in.number();
+            farm.add(now, pid, in.number());
+        } else if (type == "legacy") {
+            const uint64_t pid = in.number();
+            farm.legacy(now, pid, in.number());
+        } else if (type == "snapshot") {
+            const uint64_t pid = in.number();
+            const std::string owner(in.token());
+            const uint64_t shares = in.number();
+            farm.snapshot(pid, owner, shares, in.number());
+        } else if (type == "setweight") {
+            const uint64_t pid = in.number();
+            farm.setweight(now, pid, in.number());
+        } else if (type == "setenabled") {
+            const uint64_t pid = in.number();
+            farm.setenabled(now, pid, in.number() != 0);
+        } else if (type == "setbonus") {
+            const uint64_t pid = in.number();
+            const std::string token(in.token());
+            farm.setbonus(now, pid, token, in.number());
+        } else if (type == "fund") {
+            const std::string token(in.token());
+            farm.fund(token, in.number());
+        } else if (type == "rmpool") {
+            farm.rmpool(now, in.number());
+        } else if (type == "sweepusers") {
+            const uint64_t pid = in.number();
+            const uint64_t epoch = in.number();
+            farm.sweepusers(pid, epoch, in.number());
+        } else {
+            in.fail(type);
+        }
+        in.skip_line();
+        events++;
+    }
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+
+    farm.print();
+
+    if (argc > 2) {
+        const std::string state = read_file(argv[2]);
+        reader chain(state);
+        uint64_t diffs = 0;
+        std::map<std::pair<uint64_t, uint64_t>, bool> seen;
+        while (chain.next_line()) {
+            const uint64_t pid = chain.number();
+            const uint64_t epoch = chain.number();
+            const std::string_view owner = chain.token();
+            const uint64_t shares = chain.number();
+            const uint64_t reward_debt = chain.number();
+            const uint64_t unclaimed = chain.number();
+            chain.skip_line();
+
+            const user_state *user = farm.find_user(pid, epoch, owner);
+            if (user == nullptr) {
+                std::printf("diff %llu %llu %.*s missing-in-replay\n", engine::ull(pid), engine::ull(epoch), static_cast<int>(owner.size()), owner.data());
+                diffs++;
+                continue;
+            }
+            seen[{engine::scope(pid, epoch), name_value(owner)}] = true;
+            if (user->shares != shares || user->reward_debt != reward_debt || user->unclaimed != unclaimed) {
+                std::printf("diff %llu %llu %.*s shares %llu/%llu reward_debt %llu/%llu unclaimed %llu/%llu\n", engine::ull(pid), engine::ull(epoch),
+                    static_cast<int>(owner.size()), owner.data(),
+                    engine::ull(user->shares), engine::ull(shares), engine::ull(user->reward_debt), engine::ull(reward_debt),
+                    engine::ull(user->unclaimed), engine::ull(unclaimed));
+                diffs++;
+            }
+        }
+        for (const auto &[key, rows] : farm.users()) {
+            for (const auto &[id, user] : rows) {
+                if (seen.count({key, id})) continue;
+                std::printf("diff %llu %llu %s missing-on-chain\n", engine::ull(key & 0xffffffffffff), engine::ull(key >> 48), user.owner.c_str());
+                diffs++;
+            }
+        }
+        std::fprintf(stderr, "replay: %llu diffs\n", engine::ull(diffs));
+    }
+
+    std::fprintf(stderr, "replay: %llu events in %.3fs (%.0f events/s), minted %llu, paid %llu\n",
+        engine::ull(events), seconds, seconds > 0 ? events / seconds : 0.0, engine::ull(farm.minted()), engine::ull(farm.paid()));
+    return 0;
+}
@@ -0,0 +1,383 @@
+#include <boxlp.hpp>
+
+// Defibox LP strategy: users deposit want with memo "deposit" and the vault holds it. `crab_farm_contract`
+// only credits holders it learns of through its swap's `tokenchange`, so `earn` claims under `pid` only
+// while the vault has a `users` row there. The keeper calls `earn` and the vault compounds in one transaction:
+// earn (claim) -> earnback (fees, swaps) -> addliquidity -> farm (settle), each a self-inline
+// step so it runs after the transfers of the step before it have landed. Deposits are queued in
+// `pendings` and settled by `farm` at the post-harvest share price, withdrawals are paid immediately
+
+ACTION boxlp::init(extended_symbol want, extended_symbol token0, extended_symbol token1, extended_symbol earn, string earn_to_token0_path, string earn_to_token1_path, name crab_farm_contract, strat_fee fees, uint64_t duration) {
+    require_auth(POOL_MANAGER);
+    check(!_configs.exists(), "already initialized");
+    check(want.get_contract() == defibox::lp_code, "want must be a Defibox LP token");
+    check(token0 != token1, "token0 and token1 must differ");
+
+    uint64_t now_time = current_time_point().sec_since_epoch();
+    config_t config;
+    config.want = want;
+    config.token0 = token0;
+    config.token1 = token1;
+    config.earn = earn;
+    config.crab_farm_contract = crab_farm_contract;
+    config.earn_to_token0_path = earn_to_token0_path;
+    config.earn_to_token1_path = earn_to_token1_path;
+    config.fees = fees;
+    config.want_locked_total = 0;
+    config.shares_total = 0;
+    config.last_earn_time = now_time;
+    config.next_earn_time = now_time + duration;
+    config.duration = duration;
+    config.pid.emplace(0);
+    _configs.set(config, _self);
+}
+
+ACTION boxlp::update(extended_symbol want, extended_symbol token0, extended_symbol token1, extended_symbol earn, string earn_to_token0_path, string earn_to_token1_path, name crab_farm_contract) {
+    require_auth(POOL_MANAGER);
+    config_t config = _configs.get();
+    check(config.want == want || config.shares_total == 0, "cannot change want while shares are outstanding");
+    check(token0 != token1, "token0 and token1 must differ");
+
+    config.want = want;
+    config.token0 = token0;
+    config.token1 = token1;
+    config.earn = earn;
+    config.crab_farm_contract = crab_farm_contract;
+    config.earn_to_token0_path = earn_to_token0_path;
+    config.earn_to_token1_path = earn_to_token1_path;
+    _configs.set(config, _self);
+}
+
+ACTION boxlp::setfees(strat_fee fees) {
+    require_auth(POOL_MANAGER);
+    check(fees.controller_fee + fees.platform_fee + fees.buyback_fee <= 10000, "invalid earn fees");
+    check(fees.deposit_fee <= 10000 && fees.withdraw_fee <= 10000, "invalid deposit or withdraw fee");
+    config_t config = _configs.get();
+    config.fees = fees;
+    _configs.set(config, _self);
+}
+
+ACTION boxlp::setfeeacc(fee_account fee_accounts) {
+    require_auth(POOL_MANAGER);
+    config_t config = _configs.get();
+    config.fee_accounts = fee_accounts;
+    _configs.set(config, _self);
+}
+
+ACTION boxlp::setduration(uint64_t duration) {
+    require_auth(POOL_MANAGER);
+    config_t config = _configs.get();
+    config.duration = duration;
+    _configs.set(config, _self);
+}
+
+ACTION boxlp::setnexttime(uint64_t next_earn_time) {
+    require_auth(POOL_MANAGER);
+    config_t config = _configs.get();
+    config.next_earn_time = next_earn_time;
+    _configs.set(config, _self);
+}
+
+ACTION boxlp::setpid(uint64_t pid) {
+    require_auth(POOL_MANAGER);
+    config_t config = _configs.get();
+    check(config.want_locked_total == 0, "cannot change pid while want is locked");
+    config.pid.emplace(pid);
+    _configs.set(config, _self);
+}
+
+ACTION boxlp::setminearn(uint64_t min_earn) {
+    require_auth(POOL_MANAGER);
+    config_t config = _configs.get();
+    config.pid.emplace(config.pid.value_or(0));
+    config.min_earn.emplace(min_earn);
+    _configs.set(config, _self);
+}
+
+ACTION boxlp::setkeeper(name keeper) {
+    require_auth(POOL_MANAGER);
+    config_t config = _configs.get();
+    config.pid.emplace(config.pid.value_or(0));
+    config.min_earn.emplace(config.min_earn.value_or(0));
+    config.last_earned.emplace(config.last_earned.value_or(0));
+    config.last_earn_span.emplace(config.last_earn_span.value_or(0));
+    config.keeper.emplace(keeper);
+    _configs.set(config, _self);
+}
+
+void boxlp::ondeposit(name from, name to, asset quantity, std::string memo) {
+    if (from == _self || to != _self || memo != "deposit") return;
+    config_t config = _configs.get();
+    check(config.want == extended_symbol(quantity.symbol, get_first_receiver()), "invalid deposit");
+    check(quantity.amount > 0, "must deposit positive quantity");
+
+    action(permission_level{_self, "active"_n}, _self, "depositback"_n, make_tuple(config.pid.value_or(0), from, quantity)).send();
+}
+
+ACTION boxlp::depositback(uint64_t pid, name user_account, asset quantity) {
+    require_auth(_self);
+    config_t config = _configs.get();
+    check(pid == config.pid.value_or(0), "invalid pid");
+
+    // the want stays idle here until the next earn cycle issues shares for it
+    auto pending_itr = _pendings.find(user_account.value);
+    if (pending_itr == _pendings.end()) {
+        _pendings.emplace(_self, [&](auto &a) {
+            a.owner = user_account;
+            a.deposit = quantity;
+            a.shares = 0;
+            a.payout = asset(0, quantity.symbol);
+        });
+    } else {
+        _pendings.modify(pending_itr, same_payer, [&](auto &a) {
+            a.deposit += quantity;
+        });
+    }
+}
+
+// withdrawals are paid at once from the held want at the last settled share price,
+// rewards not yet harvested stay with the remaining shares
+ACTION boxlp::withdraw(uint64_t pid, name user_account, int128_t want_shares) {
+    require_auth(user_account);
+    config_t config = _configs.get();
+    check(pid == config.pid.value_or(0), "invalid pid");
+    check(want_shares > 0, "must withdraw positive shares");
+    auto user_itr = _users.require_find(user_account.value, "not fund user");
+
+    // rows queued before withdrawals were paid directly still settle with the next cycle
+    auto pending_itr = _pendings.find(user_account.value);
+    int128_t queued = pending_itr == _pendings.end() ? 0 : pending_itr->shares;
+    check(user_itr->shares >= queued + want_shares, "overdrawn shares");
+
+    // the withdraw fee is left in the vault and accrues to the remaining shares
+    int128_t want_amt = want_shares * config.want_locked_total / config.shares_total;
+    want_amt -= want_amt * config.fees.withdraw_fee / 10000;
+    config.shares_total -= want_shares;
+    config.want_locked_total -= want_amt;
+    _configs.set(config, _self);
+
+    if (user_itr->shares == want_shares) {
+        _users.erase(user_itr);
+    } else {
+        _users.modify(user_itr, same_payer, [&](auto &a) {
+            a.shares -= want_shares;
+        });
+    }
+
+    const asset quantity = asset(static_cast<int64_t>(want_amt), config.want.get_symbol());
+    action(permission_level{_self, "active"_n}, _self, "logwithdraw"_n, make_tuple(pid, user_account, quantity, want_shares)).send();
+    if (quantity.amount > 0) utils::inline_transfer(config.want.get_contract(), _self, user_account, quantity, "withdraw");
+}
+
+ACTION boxlp::withdraw2() {
+    require_auth(_self);
+    config_t config = _configs.get();
+    for (auto itr = _pendings.begin(); itr != _pendings.end(); itr = _pendings.erase(itr)) {
+        if (itr->payout.amount > 0) utils::inline_transfer(config.want.get_contract(), _self, itr->owner, itr->payout, "withdraw");
+    }
+}
+
+// the reward swaps take any price, so only the keeper may time them
+ACTION boxlp::earn() {
+    config_t config = _configs.get();
+    require_auth(config.keeper.value_or(POOL_MANAGER));
+    uint64_t now_time = current_time_point().sec_since_epoch();
+    check(now_time >= config.next_earn_time, "earn: too early");
+    bool queued = _pendings.begin() != _pendings.end();
+    check(config.want_locked_total > 0 || queued, "earn: nothing to do");
+
+    // the vault is only credited by the crab farm once it has a `users` row there, until then
+    // there is nothing to claim and queued deposits are settled without a harvest
+    const boxlpmath::earn_plan plan = boxlpmath::plan_earn({
+        now_time, config.last_earn_time, config.duration, MAX_EARN_DELAY,
+        config.want_locked_total > 0, queued, farmed(config),
+        config.min_earn.value_or(0), config.last_earned.value_or(0), config.last_earn_span.value_or(0)
+    });
+    if (plan.reschedule) {
+        config.next_earn_time = plan.next_earn_time;
+        _configs.set(config, _self);
+    }
+    if (!plan.harvest) {
+        if (plan.settle) action(permission_level{_self, "active"_n}, _self, "farm"_n, make_tuple()).send();
+        return;
+    }
+    earn_state_t state = _earnstates.get_or_default();
+    state.earn_before.emplace(utils::get_balance(config.earn, _self).quantity.amount);
+    _earnstates.set(state, _self);
+    action(permission_level{_self, "active"_n}, config.crab_farm_contract, "claim"_n, make_tuple(config.pid.value_or(0), _self)).send();
+    action(permission_level{_self, "active"_n}, _self, "earnback"_n, make_tuple()).send();
+}
+
+ACTION boxlp::earnback() {
+    require_auth(_self);
+    config_t config = _configs.get();
+    // only what the claim paid is harvest, earn tokens already held here are left alone
+    uint64_t before = _earnstates.get().earn_before.value_or(0);
+    uint64_t balance = utils::get_balance(config.earn, _self).quantity.amount;
+    uint64_t earned = balance > before ? balance - before : 0;
+
+    config.pid.emplace(config.pid.value_or(0));
+    config.min_earn.emplace(config.min_earn.value_or(0));
+    config.last_earned.emplace(earned);
+    config.last_earn_span.emplace(current_time_point().sec_since_epoch() - config.last_earn_time);
+    _configs.set(config, _self);
+
+    take_fee(config, config.fee_accounts.control_fee_acc, config.fees.controller_fee, earned, "controller fee");
+    take_fee(config, config.fee_accounts.platform_fee_acc, config.fees.platform_fee, earned, "platform fee");
+    take_fee(config, config.fee_accounts.buyback_fee_acc, config.fees.buyback_fee, earned, "buyback fee");
+    uint64_t rest = earned - earned * config.fees.controller_fee / 10000 - earned * config.fees.platform_fee / 10000 - earned * config.fees.buyback_fee / 10000;
+
+    uint64_t half0 = rest / 2;
+    uint64_t half1 = rest - half0;
+    // a side paid in the earn token itself keeps its half unswapped and is passed on as is,
+    // the fee transfers above have not landed yet so its balance cannot be measured
+    const uint64_t before0 = utils::get_balance(config.token0, _self).quantity.amount;
+    const uint64_t before1 = utils::get_balance(config.token1, _self).quantity.amount;
+    const uint64_t kept0 = config.token0 == config.earn ? half0 : 0;
+    const uint64_t kept1 = config.token1 == config.earn ? half1 : 0;
+    earn_state_t state{before0, before1, true};
+    state.earn_before.emplace(before);
+    _earnstates.set(state, _self);
+
+    if (config.token0 != config.earn && half0 > 0) {
+        utils::inline_transfer(config.earn.get_contract(), _self, defibox::code, asset(half0, config.earn.get_symbol()), "swap,0," + config.earn_to_token0_path);
+    }
+    if (config.token1 != config.earn && half1 > 0) {
+        utils::inline_transfer(config.earn.get_contract(), _self, defibox::code, asset(half1, config.earn.get_symbol()), "swap,0," + config.earn_to_token1_path);
+    }
+    action(permission_level{_self, "active"_n}, _self, "addliquidity"_n, make_tuple(kept0, kept1)).send();
+}
+
+// `kept0`/`kept1` are the unswapped earn token halves, the swapped sides are measured against `earnstate`
+ACTION boxlp::addliquidity(uint64_t kept0, uint64_t kept1) {
+    require_auth(_self);
+    config_t config = _configs.get();
+    earn_state_t state = _earnstates.get();
+    int64_t amount0 = config.token0 == config.earn ? kept0 : utils::get_balance(config.token0, _self).quantity.amount - state.token0_before;
+    int64_t amount1 = config.token1 == config.earn ? kept1 : utils::get_balance(config.token1, _self).quantity.amount - state.token1_before;
+
+    if (amount0 > 0 && amount1 > 0) {
+        // Defibox adds liquidity from the deposited pair balances, the unused side is refunded
+        const uint64_t pair_id = defibox::get_pairid_from_lptoken(config.want.get_symbol().code());
+        const string memo = "deposit," + std::to_string(pair_id);
+        utils::inline_transfer(config.token0.get_contract(), _self, defibox::code, asset(amount0, config.token0.get_symbol()), memo);
+        utils::inline_transfer(config.token1.get_contract(), _self, defibox::code, asset(amount1, config.token1.get_symbol()), memo);
+        action(permission_level{_self, "active"_n}, defibox::code, "deposit"_n, make_tuple(_self, pair_id)).send();
+    }
+    action(permission_level{_self, "active"_n}, _self, "farm"_n, make_tuple()).send();
+}
+
+ACTION boxlp::farm() {
+    require_auth(_self);
+    config_t config = _configs.get();
+    earn_state_t state = _earnstates.get_or_default();
+
+    // the harvest schedule only moves on a harvest, or when the first deposits start the vault
+    if (state.harvested || config.want_locked_total == 0) {
+        uint64_t now_time = current_time_point().sec_since_epoch();
+        config.last_earn_time = now_time;
+        config.next_earn_time = now_time + config.duration;
+    }
+    state.harvested = false;
+    _earnstates.set(state, _self);
+
+    settle_pending(config);
+    _configs.set(config, _self);
+}
+
+ACTION boxlp::logdeposit(uint64_t pid, name user_account, asset want_amt, int128_t shares_added) {
+    require_auth(_self);
+}
+
+ACTION boxlp::logwithdraw(uint64_t pid, name user_account, asset want_amt, int128_t shares_removed) {
+    require_auth(_self);
+}
+
+void boxlp::settle_pending(config_t &config) {
+    // all want is held here, locked want is the balance less the queued deposits,
+    // which takes in this cycle's compounded LP
+    const symbol want_sym = config.want.get_symbol();
+    const int64_t balance = utils::get_balance(config.want, _self).quantity.amount;
+    int64_t deposits = 0;
+    for (const auto &row : _pendings) deposits += row.deposit.amount;
+    config.want_locked_total = balance - deposits;
+
+    // every queued entry is priced at the same post-harvest share price
+    const int128_t locked = config.want_locked_total;
+    const int128_t total = config.shares_total;
+    const uint64_t pid = config.pid.value_or(0);
+    int64_t payouts = 0;
+    for (auto itr = _pendings.begin(); itr != _pendings.end();) {
+        int128_t shares = 0;
+        int64_t payout = 0;
+        auto user_itr = _users.find(itr->owner.value);
+
+        if (itr->deposit.amount > 0) {
+            // the deposit fee stays in the vault and accrues to existing shares
+            int128_t net = itr->deposit.amount - static_cast<int128_t>(itr->deposit.amount) * config.fees.deposit_fee / 10000;
+            int128_t shares_added = total == 0 || locked == 0 ? net : net * total / locked;
+            if (shares_added > 0) {
+                shares += shares_added;
+                config.shares_total += shares_added;
+                config.want_locked_total += itr->deposit.amount;
+                action(permission_level{_self, "active"_n}, _self, "logdeposit"_n, make_tuple(pid, itr->owner, itr->deposit, shares_added)).send();
+            } else {
+                payout += itr->deposit.amount;
+            }
+        }
+        if (itr->shares > 0) {
+            // the withdraw fee is left in the vault and accrues to the remaining shares
+            int128_t want_amt = itr->shares * locked / total;
+            want_amt -= want_amt * config.fees.withdraw_fee / 10000;
+            shares -= itr->shares;
+            config.shares_total -= itr->shares;
+            config.want_locked_total -= want_amt;
+            payout += static_cast<int64_t>(want_amt);
+            action(permission_level{_self, "active"_n}, _self, "logwithdraw"_n, make_tuple(pid, itr->owner, asset(static_cast<int64_t>(want_amt), want_sym), itr->shares)).send();
+        }
+
+        if (user_itr == _users.end()) {
+            if (shares > 0) {
+                _users.emplace(_self, [&](auto &a) {
+                    a.owner = itr->owner;
+                    a.shares = shares;
+                });
+            }
+        } else if (user_itr->shares + shares == 0) {
+            _users.erase(user_itr);
+        } else if (shares != 0) {
+            _users.modify(user_itr, same_payer, [&](auto &a) {
+                a.shares += shares;
+            });
+        }
+
+        if (payout == 0) {
+            itr = _pendings.erase(itr);
+            continue;
+        }
+        payouts += payout;
+        _pendings.modify(itr, same_payer, [&](auto &a) {
+            a.deposit.amount = 0;
+            a.shares = 0;
+            a.payout = asset(payout, want_sym);
+        });
+        itr++;
+    }
+
+    if (payouts > 0) action(permission_level{_self, "active"_n}, _self, "withdraw2"_n, make_tuple()).send();
+}
+
+bool boxlp::farmed(const config_t &config) {
+    const uint64_t pid = config.pid.value_or(0);
+    crabpools pools_tbl(config.crab_farm_contract, config.crab_farm_contract.value);
+    auto pool_itr = pools_tbl.find(pid);
+    if (pool_itr == pools_tbl.end()) return false;
+    crabusers users_tbl(config.crab_farm_contract, (pool_itr->epoch.value_or(0) << 48) | pid);
+    return users_tbl.find(_self.value) != users_tbl.end();
+}
+
+void boxlp::take_fee(const config_t &config, const name to, const uint64_t fee, const uint64_t amount, const string &memo) {
+    uint64_t fee_amount = amount * fee / 10000;
+    if (fee_amount == 0) return;
+    utils::inline_transfer(config.earn.get_contract(), _self, to, asset(fee_amount, config.earn.get_symbol()), memo);
+}
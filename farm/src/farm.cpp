@@ -1,10 +1,12 @@
 #include <farm.hpp>
+#include "./vault.cpp"
+#include "./views.cpp"
 
 ACTION farm::init(uint64_t reward_per_second) {
     require_auth(POOL_MANAGER);
-    update_all_pools();
-
     global_t gl = _globals.get_or_create(get_self(), global_t{});
+    update_index();
+
     gl.reward_per_second = reward_per_second;
     _globals.set(gl, _self);
 }
@@ -13,8 +15,14 @@ ACTION farm::add(uint64_t pid, extended_symbol want, uint64_t weight, bool displ
     require_auth(POOL_MANAGER);
     auto pool_itr = _pools.find(pid);
     if(pool_itr != _pools.end()) return;
+    check(pid < (1ULL << 48), "pid out of range");
 
     uint64_t now_time = current_time_point().sec_since_epoch();
+    uint64_t epoch = current_epoch(pid);
+    reward_index_t index = update_index();
+    index.total_weight += weight;
+    _rewardindex.set(index, _self);
+
     _pools.emplace(_self, [&](auto &a) {
         a.pid = pid;
         a.want = want;
@@ -23,42 +31,169 @@ ACTION farm::add(uint64_t pid, extended_symbol want, uint64_t weight, bool displ
         a.reward_per_share = 0;
         a.display = display;
         a.enabled = true;
+        a.reward_per_weight_paid.emplace(index.reward_per_weight);
+        a.epoch.emplace(epoch);
     });
 }
 
 ACTION farm::rmpool(uint64_t pid) {
     require_auth(POOL_MANAGER);
+    update_pool(pid);
     auto itr = _pools.require_find(pid, "not fund pool");
+    if (itr->enabled && itr->reward_per_weight_paid.has_value()) {
+        reward_index_t index = _rewardindex.get();
+        index.total_weight -= itr->weight;
+        _rewardindex.set(index, _self);
+    }
+
+    // the next listing writes to a fresh scope, rows of this one are left to `sweepusers`
+    uint64_t next_epoch = itr->epoch.value_or(0) + 1;
+    _retireds.emplace(_self, [&](auto &a) {
+        a.scope = user_scope(pid, itr->epoch.value_or(0));
+        a.reward_per_share = itr->reward_per_share;
+        a.bonuses.emplace(itr->bonuses.value_or(vector<bonus_slot>{}));
+    });
     _pools.erase(itr);
+    auto epoch_itr = _epochs.find(pid);
+    if (epoch_itr == _epochs.end()) {
+        _epochs.emplace(_self, [&](auto &a) {
+            a.pid = pid;
+            a.epoch = next_epoch;
+        });
+    } else {
+        _epochs.modify(epoch_itr, same_payer, [&](auto &a) {
+            a.epoch = next_epoch;
+        });
+    }
+}
 
-    users _users(_self, pid);
-    auto user_itr = _users.begin();
-    while(user_itr != _users.end()) {
-        _users.erase(user_itr);
-        user_itr = _users.begin();
+// rows are paid against the retired listing's final indexes; a row whose bonuses the farm
+// could not fund is kept with only those left on it, sweep again once the farm is topped up
+ACTION farm::sweepusers(uint64_t pid, uint64_t epoch, uint64_t limit) {
+    require_auth(POOL_MANAGER);
+    const uint64_t active_epoch = current_epoch(pid);
+    check(epoch < active_epoch, "epoch is still active");
+
+    auto pool_itr = _pools.find(pid);
+    users _users(_self, user_scope(pid, epoch));
+    users _active_users(_self, user_scope(pid, active_epoch));
+    // listings removed before `retired` existed only have their `unclaimed` left to pay
+    auto retired_itr = _retireds.find(user_scope(pid, epoch));
+    const vector<bonus_slot> slots = retired_itr == _retireds.end() ? vector<bonus_slot>{} : retired_itr->bonuses.value_or(vector<bonus_slot>{});
+    // amounts already queued in this batch, so the balance cap of `take_bonuses` holds across it
+    vector<extended_asset> swept;
+    for (auto user_itr = _users.begin(); user_itr != _users.end() && limit > 0; limit--) {
+        user_t row = *user_itr;
+        uint64_t pending = row.unclaimed.value_or(0);
+        if (retired_itr != _retireds.end()) pending += farmmath::user_pending(row.shares, retired_itr->reward_per_share, row.reward_debt);
+        if (row.owner != _self && pending > 0) {
+            utils::inline_transfer(REWARD_CONTRACT, _self, row.owner, asset(pending, REWARD_SYMBOL), string("reward token"));
+        }
+
+        accrue_bonuses(slots, row, 0);
+        const vector<extended_asset> queued = swept;
+        take_bonuses(slots, row, swept);
+        for (size_t i = 0; i < swept.size(); i++) {
+            int64_t amount = swept[i].quantity.amount - (i < queued.size() ? queued[i].quantity.amount : 0);
+            if (amount > 0) utils::inline_transfer(swept[i].contract, _self, row.owner, asset(amount, swept[i].quantity.symbol), string("bonus reward"));
+        }
+
+        if (has_bonuses(row)) {
+            _users.modify(user_itr, same_payer, [&](auto &a) {
+                a = row;
+                a.shares = 0;
+                a.reward_debt = 0;
+                a.unclaimed.emplace(0);
+            });
+            user_itr++;
+            continue;
+        }
+
+        bool active = pool_itr != _pools.end() && _active_users.find(row.owner.value) != _active_users.end();
+        if (!active) {
+            stakes _stakes(_self, row.owner.value);
+            auto stake_itr = _stakes.find(pid);
+            if (stake_itr != _stakes.end()) _stakes.erase(stake_itr);
+        }
+        user_itr = _users.erase(user_itr);
     }
+    if (_users.begin() == _users.end() && retired_itr != _retireds.end()) _retireds.erase(retired_itr);
 }
 
 void farm::clearuser(uint64_t pid, name owner) {
     require_auth(POOL_MANAGER);
-    users _users(_self, pid);
+    users _users(_self, user_scope(pid, current_epoch(pid)));
     auto m_itr = _users.require_find(owner.value, "Pair does not exist.");
     _users.erase(m_itr);
+
+    stakes _stakes(_self, owner.value);
+    auto stake_itr = _stakes.find(pid);
+    if(stake_itr != _stakes.end()) _stakes.erase(stake_itr);
 }
 
 ACTION farm::setrewardper(uint64_t reward_per_second) {
     require_auth(POOL_MANAGER);
-    update_all_pools();
+    update_index();
 
     global_t gl = _globals.get();
     gl.reward_per_second = reward_per_second;
     _globals.set(gl, _self);
 }
 
+ACTION farm::setepoch(uint64_t epoch_length) {
+    require_auth(POOL_MANAGER);
+    check(epoch_length > 0, "epoch length must be positive");
+    budget_t budget = _budgets.get_or_default(budget_t{DEFAULT_EPOCH_LENGTH, 0, 0});
+    budget.epoch_length = epoch_length;
+    _budgets.set(budget, _self);
+}
+
+ACTION farm::setthreshold(uint64_t payout_threshold) {
+    require_auth(POOL_MANAGER);
+    global_t gl = _globals.get();
+    gl.payout_threshold.emplace(payout_threshold);
+    _globals.set(gl, _self);
+}
+
+ACTION farm::setkeeper(name keeper) {
+    require_auth(POOL_MANAGER);
+    global_t gl = _globals.get();
+    gl.payout_threshold.emplace(gl.payout_threshold.value_or(0));
+    gl.keeper.emplace(keeper);
+    _globals.set(gl, _self);
+}
+
+ACTION farm::setbonus(uint64_t pid, extended_symbol token, uint64_t per_second) {
+    require_auth(POOL_MANAGER);
+    // bonuses are paid from the farm's balance, which also holds the WDOGE budget and the vaults' LP
+    check(token != extended_symbol(REWARD_SYMBOL, REWARD_CONTRACT), "bonus token cannot be the reward token");
+    check(token.get_contract() != LPTOKEN_CONTRACT, "bonus token cannot be an LP token");
+    update_pool(pid);
+    auto pool_itr = _pools.require_find(pid, "not fund pid");
+    vector<bonus_slot> slots = pool_itr->bonuses.value_or(vector<bonus_slot>{});
+    auto slot_itr = std::find_if(slots.begin(), slots.end(), [&](const bonus_slot &slot) { return slot.token == token; });
+    if (slot_itr == slots.end()) {
+        check(slots.size() < MAX_BONUS_SLOTS, "bonus slots are full");
+        slots.push_back(bonus_slot{token, per_second, 0});
+    } else {
+        slot_itr->per_second = per_second;
+    }
+
+    _pools.modify(pool_itr, same_payer, [&](auto &a) {
+        if (!a.epoch.has_value()) a.epoch.emplace(0);
+        a.bonuses.emplace(slots);
+    });
+}
+
 ACTION farm::setweight(uint64_t pid, uint64_t weight) {
     require_auth(POOL_MANAGER);
     update_pool(pid);
     auto pool_itr = _pools.require_find(pid, "not fund pid");
+    if (pool_itr->enabled) {
+        reward_index_t index = _rewardindex.get();
+        index.total_weight = index.total_weight + weight - pool_itr->weight;
+        _rewardindex.set(index, _self);
+    }
     _pools.modify(pool_itr, same_payer, [&](auto &a) {
         a.weight = weight;
     });
@@ -77,89 +212,137 @@ ACTION farm::setenabled(uint64_t pid, bool enabled) {
     update_pool(pid);
     uint64_t now_time = current_time_point().sec_since_epoch();
     auto pool_itr = _pools.require_find(pid, "not fund pid");
+    if (pool_itr->enabled != enabled) {
+        reward_index_t index = _rewardindex.get();
+        index.total_weight = enabled ? index.total_weight + pool_itr->weight : index.total_weight - pool_itr->weight;
+        _rewardindex.set(index, _self);
+    }
     _pools.modify(pool_itr, same_payer, [&](auto &a) {
         a.enabled = enabled;
         a.last_reward_time = now_time;
     });
 }
 
-void farm::update_all_pools() {
-    auto itr = _pools.begin();
-    while(itr != _pools.end()) {
-        update_pool(itr->pid);
-        itr++;
+farm::reward_index_t farm::projected_index() {
+    uint64_t now_time = current_time_point().sec_since_epoch();
+    reward_index_t index = _rewardindex.get_or_default(reward_index_t{0, 0, now_time});
+    if (now_time > index.last_update_time) {
+        global_t global = _globals.get();
+        index.reward_per_weight = farmmath::advance_index(index.reward_per_weight, index.last_update_time, now_time, global.reward_per_second);
+        index.last_update_time = now_time;
     }
+    return index;
+}
+
+farm::reward_index_t farm::update_index() {
+    reward_index_t index = projected_index();
+    _rewardindex.set(index, _self);
+    return index;
+}
+
+// pools listed before the index have no paid value yet, their first settlement accrues the time
+// since `last_reward_time` at the current rate, independent of when the index started
+uint64_t farm::accrued_reward(const pool_t &pool, uint128_t reward_per_weight) {
+    uint128_t reward = 0;
+    if (pool.reward_per_weight_paid.has_value()) {
+        reward = farmmath::pool_reward(reward_per_weight, pool.reward_per_weight_paid.value(), pool.weight, pool.enabled, pool.shares_total);
+    } else {
+        uint64_t now_time = current_time_point().sec_since_epoch();
+        uint128_t accrued = farmmath::legacy_accrual(pool.last_reward_time, now_time, _globals.get().reward_per_second);
+        reward = farmmath::pool_reward(accrued, 0, pool.weight, pool.enabled, pool.shares_total);
+    }
+    check(reward <= farmmath::MAX_REWARD, "update_pool: reward overflow");
+    return static_cast<uint64_t>(reward);
 }
 
 void farm::update_pool(uint64_t pid) {
     auto pool_itr = _pools.find(pid);
     if(pool_itr == _pools.end()) return;
-    if (!pool_itr->enabled) return;
 
     uint64_t now_time = current_time_point().sec_since_epoch();
-    if (now_time <= pool_itr->last_reward_time) {
-        return;
+    reward_index_t index = update_index();
+    uint64_t reward = accrued_reward(*pool_itr, index.reward_per_weight);
+    if (!pool_itr->reward_per_weight_paid.has_value() && pool_itr->enabled) {
+        index.total_weight += pool_itr->weight;
+        _rewardindex.set(index, _self);
     }
 
-    if (pool_itr->shares_total == 0) {
-        _pools.modify(pool_itr, same_payer, [&](auto &a) {
-            a.last_reward_time = now_time;
-        });
-        return;
-    }
-
-    uint64_t multiplier = now_time - pool_itr->last_reward_time;
-    if (multiplier <= 0) {
-        return;
-    }
-
-    global_t global = _globals.get();
-    uint64_t reward = multiplier * global.reward_per_second * pool_itr->weight;
-    if (reward == 0) {
-        _pools.modify(pool_itr, same_payer, [&](auto &a) {
-            a.last_reward_time = now_time;
-        });
-        return;
-    }
-
-    uint64_t reward_per_share = pool_itr->reward_per_share + reward/pool_itr->shares_total;
+    uint64_t elapsed = now_time > pool_itr->last_reward_time ? now_time - pool_itr->last_reward_time : 0;
     _pools.modify(pool_itr, same_payer, [&](auto &a) {
-        a.reward_per_share = reward_per_share;
+        if (reward > 0) {
+            a.reward_per_share += farmmath::reward_per_share_step(reward, a.shares_total);
+            a.total_rewards += reward;
+        }
+        // bonus slots settle in the same pass, on the pool's own elapsed time
+        if (a.bonuses.has_value() && a.enabled && a.shares_total > 0 && elapsed > 0) {
+            vector<bonus_slot> slots = a.bonuses.value();
+            for (auto &slot : slots) {
+                slot.acc_per_share += farmmath::bonus_step(elapsed, slot.per_second, a.shares_total);
+            }
+            a.bonuses.emplace(slots);
+        }
+        a.reward_per_weight_paid.emplace(index.reward_per_weight);
         a.last_reward_time = now_time;
-        a.total_rewards += reward;
     });
+    if (reward > 0) draw_budget(reward);
+}
 
-    asset rewards(reward, REWARD_SYMBOL);
-    auto data = make_tuple(_self, _self, rewards, string("issue token"));
-    action(permission_level{_self, "active"_n}, REWARD_CONTRACT, "mint"_n, data).send();
+// mints one epoch of emission at a time when the budget runs dry
+void farm::draw_budget(uint64_t reward) {
+    budget_t budget = _budgets.get_or_default(budget_t{DEFAULT_EPOCH_LENGTH, 0, 0});
+    if (budget.balance < reward) {
+        global_t global = _globals.get();
+        reward_index_t index = _rewardindex.get();
+        uint128_t amount = farmmath::budget_mint(budget.balance, reward, global.reward_per_second, index.total_weight, budget.epoch_length);
+        check(amount <= asset::max_amount, "epoch budget overflow");
+
+        budget.balance += static_cast<uint64_t>(amount);
+        budget.last_mint_time = current_time_point().sec_since_epoch();
+        asset rewards(static_cast<int64_t>(amount), REWARD_SYMBOL);
+        auto data = make_tuple(_self, _self, rewards, string("issue token"));
+        action(permission_level{_self, "active"_n}, REWARD_CONTRACT, "mint"_n, data).send();
+    }
+
+    budget.balance -= reward;
+    _budgets.set(budget, _self);
 }
 
 void farm::onlptokenchange(symbol_code code, uint64_t pid, name owner, uint64_t pre_amount, uint64_t now_amount) { 
     check(get_first_receiver() == SWAP_CONTRACT, "invalid contract code");
     require_auth(SWAP_CONTRACT);
+    if(pre_amount == now_amount) return;
+    settle_change(pid, owner, pre_amount, now_amount);
+}
 
+void farm::settle_change(uint64_t pid, name owner, uint64_t pre_amount, uint64_t now_amount) {
     update_pool(pid);
     auto pool_itr = _pools.find(pid);
     if(pool_itr == _pools.end()) return;
     if(!pool_itr->enabled) return;
 
     string action = (now_amount - pre_amount) > 0 ? "deposit" : "withdraw";
-    users _users(_self, pid);
+    users _users(_self, user_scope(pid, pool_itr->epoch.value_or(0)));
     auto user_itr = _users.find(owner.value);
     if(action == "withdraw" && user_itr == _users.end()) return;
 
     uint64_t now_time = current_time_point().sec_since_epoch();
     if(pool_itr->shares_total == 0) {
         _pools.modify(pool_itr, same_payer, [&](auto &a) {
-            a.reward_per_share = 0;
-            a.total_rewards = 0;
-            a.last_reward_time = now_time;
+            farmmath::reset_if_empty(a, now_time);
         });
     }
     
+    stakes _stakes(_self, owner.value);
     if(user_itr == _users.end()) {
+        if(_stakes.find(pid) == _stakes.end()) {
+            _stakes.emplace(_self, [&](auto &a) {
+                a.pid = pid;
+            });
+        }
         _users.emplace(_self, [&](auto &a) {
             a.owner = owner;
+            a.shares = 0;
+            accrue_bonuses(pool_itr->bonuses.value_or(vector<bonus_slot>{}), a, now_amount);
             a.shares = now_amount;
             a.reward_debt = now_amount * pool_itr->reward_per_share;
             a.last_staked_time = now_time;
@@ -175,13 +358,25 @@ void farm::onlptokenchange(symbol_code code, uint64_t pid, name owner, uint64_t
         });
     }
     
-    int128_t pending = user_itr->shares * pool_itr->reward_per_share - user_itr->reward_debt;
-    if(now_amount == 0) {
+    const farmmath::settlement settled = farmmath::settle_rewards(user_itr->shares, pool_itr->reward_per_share, user_itr->reward_debt, user_itr->unclaimed.value_or(0),
+        now_amount, _globals.get().payout_threshold.value_or(0), owner == _self);
+    const uint64_t payout = settled.payout;
+    const uint64_t unclaimed = settled.unclaimed;
+
+    // bonus rewards accrue until claimed, a closed position keeps its row while any are left
+    user_t row = *user_itr;
+    accrue_bonuses(pool_itr->bonuses.value_or(vector<bonus_slot>{}), row, now_amount);
+
+    if(now_amount == 0 && !has_bonuses(row)) {
         _users.erase(user_itr);
+        auto stake_itr = _stakes.find(pid);
+        if(stake_itr != _stakes.end()) _stakes.erase(stake_itr);
     } else {
         _users.modify(user_itr, same_payer, [&](auto &a) {
+            a = row;
             a.shares = now_amount;
             a.reward_debt = now_amount * pool_itr->reward_per_share;
+            a.unclaimed.emplace(unclaimed);
             if(action == "deposit") a.last_staked_time = now_time;
             if(action == "withdraw") a.last_withdraw_time = now_time;
         });
@@ -190,36 +385,140 @@ void farm::onlptokenchange(symbol_code code, uint64_t pid, name owner, uint64_t
     pool_itr = _pools.find(pid);
     if(pool_itr->shares_total == 0) {
         _pools.modify(pool_itr, same_payer, [&](auto &a) {
-            a.reward_per_share = 0;
-            a.total_rewards = 0;
-            a.last_reward_time = now_time;
+            farmmath::reset_if_empty(a, now_time);
         });
     }
 
-    if (pending > 0) {
-        asset reward = asset(pending, REWARD_SYMBOL);
+    if (payout > 0) {
+        asset reward = asset(payout, REWARD_SYMBOL);
         utils::inline_transfer(REWARD_CONTRACT, _self, owner, reward, string("reward token"));
     }     
 }
 
 ACTION farm::claim(uint64_t pid, name owner) {
     require_auth(owner);
-    update_pool(pid);
-
-    users _users(_self, pid);
     auto pool_itr = _pools.require_find(pid, "not fund pid");
-    auto user_itr = _users.require_find(owner.value, "not fund user");
-    check(user_itr->shares > 0, "user shares is 0");
+    users _users(_self, user_scope(pid, pool_itr->epoch.value_or(0)));
+    _users.require_find(owner.value, "not fund user");
 
-    uint64_t pending = user_itr->shares * pool_itr->reward_per_share - user_itr->reward_debt;
+    vector<extended_asset> bonuses;
+    uint64_t pending = harvest(pid, owner, bonuses);
+    pay_bonuses(owner, bonuses);
+    if (pending <= 0) return;
+
+    asset reward = asset(pending, REWARD_SYMBOL);
+    utils::inline_transfer(REWARD_CONTRACT, _self, owner, reward, string("reward token"));
+}
+
+// an empty pid list harvests every pool recorded in the owner's `stakes`
+ACTION farm::claimall(name owner, vector<uint64_t> pids) {
+    require_auth(owner);
+    if (pids.empty()) {
+        stakes _stakes(_self, owner.value);
+        for (auto itr = _stakes.begin(); itr != _stakes.end(); itr++) {
+            pids.push_back(itr->pid);
+        }
+    }
+
+    uint64_t pending = 0;
+    vector<extended_asset> bonuses;
+    for (auto pid : pids) {
+        pending += harvest(pid, owner, bonuses);
+    }
+    pay_bonuses(owner, bonuses);
     if (pending <= 0) return;
 
     asset reward = asset(pending, REWARD_SYMBOL);
-    if(reward.amount <= 0) return;
+    utils::inline_transfer(REWARD_CONTRACT, _self, owner, reward, string("reward token"));
+}
+
+// closed positions are only kept for their bonuses, the row goes once those are paid out
+uint64_t farm::harvest(uint64_t pid, name owner, vector<extended_asset> &bonuses) {
+    auto pool_itr = _pools.find(pid);
+    if (pool_itr == _pools.end()) return 0;
+    update_pool(pid);
+
+    users _users(_self, user_scope(pid, pool_itr->epoch.value_or(0)));
+    auto user_itr = _users.find(owner.value);
+    if (user_itr == _users.end()) return 0;
+
+    user_t row = *user_itr;
+    const vector<bonus_slot> slots = pool_itr->bonuses.value_or(vector<bonus_slot>{});
+    accrue_bonuses(slots, row, row.shares);
+    take_bonuses(slots, row, bonuses);
+
+    uint64_t pending = farmmath::user_pending(row.shares, pool_itr->reward_per_share, row.reward_debt) + row.unclaimed.value_or(0);
+    if (row.shares == 0 && !has_bonuses(row)) {
+        _users.erase(user_itr);
+        stakes _stakes(_self, owner.value);
+        auto stake_itr = _stakes.find(pid);
+        if (stake_itr != _stakes.end()) _stakes.erase(stake_itr);
+        return pending;
+    }
+
+    row.reward_debt = row.shares * pool_itr->reward_per_share;
+    row.unclaimed.emplace(0);
     _users.modify(user_itr, same_payer, [&](auto &a) {
-        a.reward_debt = user_itr->shares * pool_itr->reward_per_share;
+        a = row;
     });
+    return pending;
+}
 
-    utils::inline_transfer(REWARD_CONTRACT, _self, owner, reward, string("reward token"));
+// moves the bonus rewards earned on the user's current shares into `bonus_unclaimed`
+// and resets the debts for `now_shares`, slots added after the last settlement start at zero debt
+// the farm's own vault position earns no bonuses
+void farm::accrue_bonuses(const vector<bonus_slot> &slots, user_t &user, uint64_t now_shares) {
+    if (slots.empty() || user.owner == _self) return;
+    vector<uint128_t> debt = user.bonus_debt.value_or(vector<uint128_t>{});
+    vector<uint64_t> unclaimed = user.bonus_unclaimed.value_or(vector<uint64_t>{});
+    debt.resize(slots.size(), 0);
+    unclaimed.resize(slots.size(), 0);
+    for (size_t i = 0; i < slots.size(); i++) {
+        uint128_t earned = farmmath::bonus_debt(user.shares, slots[i].acc_per_share);
+        if (earned > debt[i]) unclaimed[i] += static_cast<uint64_t>(earned - debt[i]);
+        debt[i] = farmmath::bonus_debt(now_shares, slots[i].acc_per_share);
+    }
+
+    if (!user.unclaimed.has_value()) user.unclaimed.emplace(0);
+    user.bonus_debt.emplace(debt);
+    user.bonus_unclaimed.emplace(unclaimed);
 }
 
+// takes what the farm can fund, the rest stays in `bonus_unclaimed` until the slot is topped up
+void farm::take_bonuses(const vector<bonus_slot> &slots, user_t &user, vector<extended_asset> &bonuses) {
+    if (slots.empty() || !user.bonus_unclaimed.has_value()) return;
+    vector<uint64_t> unclaimed = user.bonus_unclaimed.value();
+    for (size_t i = 0; i < slots.size() && i < unclaimed.size(); i++) {
+        if (unclaimed[i] == 0) continue;
+        auto bonus_itr = std::find_if(bonuses.begin(), bonuses.end(), [&](const extended_asset &b) { return b.get_extended_symbol() == slots[i].token; });
+        int64_t taken = bonus_itr == bonuses.end() ? 0 : bonus_itr->quantity.amount;
+        int64_t available = utils::get_balance(slots[i].token, _self).quantity.amount - taken;
+        uint64_t amount = available <= 0 ? 0 : std::min(unclaimed[i], static_cast<uint64_t>(available));
+        if (amount == 0) continue;
+        if (bonus_itr == bonuses.end()) {
+            bonuses.push_back(extended_asset(amount, slots[i].token));
+        } else {
+            bonus_itr->quantity.amount += amount;
+        }
+        unclaimed[i] -= amount;
+    }
+    user.bonus_unclaimed.emplace(unclaimed);
+}
+
+bool farm::has_bonuses(const user_t &user) {
+    const vector<uint64_t> unclaimed = user.bonus_unclaimed.value_or(vector<uint64_t>{});
+    return std::any_of(unclaimed.begin(), unclaimed.end(), [](uint64_t amount) { return amount > 0; });
+}
+
+void farm::pay_bonuses(name owner, const vector<extended_asset> &bonuses) {
+    for (const auto &bonus : bonuses) {
+        utils::inline_transfer(bonus.contract, _self, owner, bonus.quantity, string("bonus reward"));
+    }
+}
+
+uint64_t farm::current_epoch(uint64_t pid) {
+    auto pool_itr = _pools.find(pid);
+    if (pool_itr != _pools.end()) return pool_itr->epoch.value_or(0);
+    auto epoch_itr = _epochs.find(pid);
+    return epoch_itr == _epochs.end() ? 0 : epoch_itr->epoch;
+}
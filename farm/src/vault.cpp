@@ -0,0 +1,129 @@
+// opt-in compounding vaults: owners deposit LP with memo "vault,<pid>" and receive shares,
+// a keeper calls `compound` to turn the vault's farm rewards into more LP for all of them
+
+ACTION farm::openvault(uint64_t pid, extended_symbol token0, extended_symbol token1, string earn_to_token0_path, string earn_to_token1_path) {
+    require_auth(POOL_MANAGER);
+    auto pool_itr = _pools.require_find(pid, "not fund pid");
+    check(pool_itr->want.get_contract() == LPTOKEN_CONTRACT, "vault only supports swap LP");
+    check(_vaults.find(pid) == _vaults.end(), "vault already exists");
+
+    _vaults.emplace(_self, [&](auto &a) {
+        a.pid = pid;
+        a.token0 = token0;
+        a.token1 = token1;
+        a.earn_to_token0_path = earn_to_token0_path;
+        a.earn_to_token1_path = earn_to_token1_path;
+        a.shares_total = 0;
+        a.last_compound_time = current_time_point().sec_since_epoch();
+    });
+}
+
+void farm::on_lptransfer(name from, name to, asset quantity, std::string memo) {
+    if (from == _self || to != _self) return;
+    const vector<string> parts = utils::split(memo, ",");
+    if (parts.size() != 2 || parts[0] != "vault") return;
+
+    uint64_t pid = std::stoull(parts[1]);
+    auto vault_itr = _vaults.require_find(pid, "vault does not exist");
+    auto pool_itr = _pools.require_find(pid, "not fund pid");
+    check(pool_itr->want == extended_symbol(quantity.symbol, get_first_receiver()), "invalid vault deposit");
+
+    // the transfer is already applied, the vault held `balance - quantity` before it
+    uint64_t balance = utils::get_balance(pool_itr->want, _self).quantity.amount;
+    uint64_t held = balance - quantity.amount;
+    uint64_t shares = vault_itr->shares_total == 0 || held == 0 ? quantity.amount : static_cast<uint64_t>(static_cast<uint128_t>(quantity.amount) * vault_itr->shares_total / held);
+    check(shares > 0, "deposit too small");
+
+    _vaults.modify(vault_itr, same_payer, [&](auto &a) {
+        a.shares_total += shares;
+    });
+
+    vaultusers _vaultusers(_self, pid);
+    auto user_itr = _vaultusers.find(from.value);
+    if (user_itr == _vaultusers.end()) {
+        _vaultusers.emplace(_self, [&](auto &a) {
+            a.owner = from;
+            a.shares = shares;
+        });
+    } else {
+        _vaultusers.modify(user_itr, same_payer, [&](auto &a) {
+            a.shares += shares;
+        });
+    }
+}
+
+ACTION farm::vaultexit(name owner, uint64_t pid, uint64_t shares) {
+    require_auth(owner);
+    auto vault_itr = _vaults.require_find(pid, "vault does not exist");
+    auto pool_itr = _pools.require_find(pid, "not fund pid");
+    vaultusers _vaultusers(_self, pid);
+    auto user_itr = _vaultusers.require_find(owner.value, "not fund user");
+    check(shares > 0 && shares <= user_itr->shares, "invalid shares");
+
+    uint64_t balance = utils::get_balance(pool_itr->want, _self).quantity.amount;
+    uint64_t amount = static_cast<uint64_t>(static_cast<uint128_t>(shares) * balance / vault_itr->shares_total);
+
+    _vaults.modify(vault_itr, same_payer, [&](auto &a) {
+        a.shares_total -= shares;
+    });
+    if (user_itr->shares == shares) {
+        _vaultusers.erase(user_itr);
+    } else {
+        _vaultusers.modify(user_itr, same_payer, [&](auto &a) {
+            a.shares -= shares;
+        });
+    }
+
+    if (amount > 0) {
+        utils::inline_transfer(LPTOKEN_CONTRACT, _self, owner, asset(amount, pool_itr->want.get_symbol()), string("vault withdraw"));
+    }
+}
+
+// harvests the vault once for all participants, swaps half of the reward into each side
+// and leaves `compoundadd` to add the proceeds as liquidity once the swaps have settled.
+// The keeper times the swaps and bounds them with `min_return0`/`min_return1`
+ACTION farm::compound(uint64_t pid, uint64_t min_return0, uint64_t min_return1) {
+    require_auth(_globals.get().keeper.value_or(POOL_MANAGER));
+    auto vault_itr = _vaults.require_find(pid, "vault does not exist");
+    vector<extended_asset> bonuses;
+    uint64_t reward = harvest(pid, _self, bonuses);
+    if (reward == 0) return;
+
+    // the harvest may mint budget inline, so a WDOGE side is passed on as is and only
+    // the swapped sides are measured, against balances of tokens the mint does not touch
+    const extended_symbol earn = extended_symbol(REWARD_SYMBOL, REWARD_CONTRACT);
+    const uint64_t half0 = reward / 2;
+    const uint64_t half1 = reward - half0;
+    const uint64_t kept0 = vault_itr->token0 == earn ? half0 : 0;
+    const uint64_t kept1 = vault_itr->token1 == earn ? half1 : 0;
+
+    _vaults.modify(vault_itr, same_payer, [&](auto &a) {
+        a.token0_before = utils::get_balance(a.token0, _self).quantity.amount;
+        a.token1_before = utils::get_balance(a.token1, _self).quantity.amount;
+        a.last_compound_time = current_time_point().sec_since_epoch();
+    });
+
+    if (vault_itr->token0 != earn) {
+        utils::inline_transfer(REWARD_CONTRACT, _self, SWAP_CONTRACT, asset(half0, REWARD_SYMBOL), "swap," + std::to_string(min_return0) + "," + vault_itr->earn_to_token0_path);
+    }
+    if (vault_itr->token1 != earn) {
+        utils::inline_transfer(REWARD_CONTRACT, _self, SWAP_CONTRACT, asset(half1, REWARD_SYMBOL), "swap," + std::to_string(min_return1) + "," + vault_itr->earn_to_token1_path);
+    }
+    action(permission_level{_self, "active"_n}, _self, "compoundadd"_n, make_tuple(pid, kept0, kept1)).send();
+}
+
+// `kept0`/`kept1` are the unswapped WDOGE halves, the swapped sides are measured against the vault snapshot
+ACTION farm::compoundadd(uint64_t pid, uint64_t kept0, uint64_t kept1) {
+    require_auth(_self);
+    auto vault_itr = _vaults.require_find(pid, "vault does not exist");
+    const extended_symbol earn = extended_symbol(REWARD_SYMBOL, REWARD_CONTRACT);
+    int64_t amount0 = vault_itr->token0 == earn ? kept0 : utils::get_balance(vault_itr->token0, _self).quantity.amount - vault_itr->token0_before;
+    int64_t amount1 = vault_itr->token1 == earn ? kept1 : utils::get_balance(vault_itr->token1, _self).quantity.amount - vault_itr->token1_before;
+    if (amount0 <= 0 || amount1 <= 0) return;
+
+    // the minted LP lands on the farm account and is farmed through `tokenchange` like any holder
+    const string memo = "deposit," + std::to_string(pid);
+    utils::inline_transfer(vault_itr->token0.get_contract(), _self, SWAP_CONTRACT, asset(amount0, vault_itr->token0.get_symbol()), memo);
+    utils::inline_transfer(vault_itr->token1.get_contract(), _self, SWAP_CONTRACT, asset(amount1, vault_itr->token1.get_symbol()), memo);
+    action(permission_level{_self, "active"_n}, SWAP_CONTRACT, "deposit"_n, make_tuple(_self, pid)).send();
+}
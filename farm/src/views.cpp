@@ -0,0 +1,44 @@
+// read-only views, they project the pool to the current time with the same arithmetic
+// as `update_pool` and never write, so they can be pushed as dry-run or read-only calls
+
+asset farm::pending(uint64_t pid, name owner) {
+    auto pool_itr = _pools.require_find(pid, "not fund pid");
+    users _users(_self, user_scope(pid, pool_itr->epoch.value_or(0)));
+    auto user_itr = _users.find(owner.value);
+    if (user_itr == _users.end()) return asset(0, REWARD_SYMBOL);
+
+    uint64_t reward_per_share = pool_itr->reward_per_share;
+    uint64_t reward = accrued_reward(*pool_itr, projected_index().reward_per_weight);
+    if (reward > 0) reward_per_share += farmmath::reward_per_share_step(reward, pool_itr->shares_total);
+
+    uint64_t pending = farmmath::user_pending(user_itr->shares, reward_per_share, user_itr->reward_debt) + user_itr->unclaimed.value_or(0);
+    return asset(pending, REWARD_SYMBOL);
+}
+
+asset farm::emission(uint64_t pid) {
+    auto pool_itr = _pools.require_find(pid, "not fund pid");
+    if (!pool_itr->enabled) return asset(0, REWARD_SYMBOL);
+    return asset(_globals.get().reward_per_second * pool_itr->weight, REWARD_SYMBOL);
+}
+
+farm::pool_view farm::poolinfo(uint64_t pid) {
+    auto pool_itr = _pools.require_find(pid, "not fund pid");
+    reward_index_t index = projected_index();
+
+    uint64_t reward_per_share = pool_itr->reward_per_share;
+    uint64_t reward = accrued_reward(*pool_itr, index.reward_per_weight);
+    if (reward > 0) reward_per_share += farmmath::reward_per_share_step(reward, pool_itr->shares_total);
+
+    const asset per_second = emission(pid);
+    return pool_view{
+        pool_itr->pid,
+        pool_itr->want,
+        pool_itr->weight,
+        pool_itr->enabled,
+        asset(pool_itr->shares_total, pool_itr->want.get_symbol()),
+        reward_per_share,
+        per_second,
+        per_second * 365 * 86400,
+        index.total_weight
+    };
+}
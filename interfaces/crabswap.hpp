@@ -57,6 +57,19 @@ namespace crabswap {
       indexed_by < name("lptokencode"), const_mem_fun < pairs_row, uint64_t, &pairs_row::lptoken_code_id>>,
       indexed_by < name("byhash"), const_mem_fun < pairs_row, checksum256, &pairs_row::hash>>> pairs;
 
+    /**
+     * Compact reserves mirror of pairs
+     */
+    struct [[eosio::table]] reserves_row {
+        uint64_t id;
+        asset reserve0;
+        asset reserve1;
+        asset liquidity;
+
+        uint64_t primary_key() const { return id; }
+    };
+    typedef eosio::multi_index< "reserves"_n, reserves_row > reserves;
+
     /**
      * Defibox stat
      */
@@ -94,8 +107,8 @@ namespace crabswap {
      */
     static std::pair<asset, asset> get_reserves( const uint64_t pair_id, const symbol sort )
     {
-        crabswap::pairs _pairs( code, code.value );
-        auto pairs = _pairs.get( pair_id, "AiSwapLibrary: INVALID_PAIR_ID" );
+        crabswap::reserves _reserves( code, code.value );
+        auto pairs = _reserves.get( pair_id, "AiSwapLibrary: INVALID_PAIR_ID" );
 
         eosio::check( pairs.reserve0.symbol == sort || pairs.reserve1.symbol == sort, "AiSwapLibrary: sort symbol doesn't match");
 
@@ -114,8 +127,8 @@ namespace crabswap {
     static asset get_user_eos( const uint64_t pair_id, uint64_t user_lptoken)
     {
         // table
-        crabswap::pairs _pairs( code, code.value );
-        auto pairs = _pairs.get( pair_id, "AiSwapLibrary: INVALID_PAIR_ID" );
+        crabswap::reserves _reserves( code, code.value );
+        auto pairs = _reserves.get( pair_id, "AiSwapLibrary: INVALID_PAIR_ID" );
         eosio::check( pairs.reserve0.symbol == EOS_SYMBOL || pairs.reserve1.symbol == EOS_SYMBOL, "SwapLibrary: sort symbol doesn't match");
 
         asset reserve_eos = EOS_SYMBOL == pairs.reserve0.symbol ?
@@ -45,6 +45,19 @@ namespace swap {
     };
     typedef eosio::multi_index< "pairs"_n, pairs_row > pairs;
 
+    /**
+     * Compact reserves mirror of pairs
+     */
+    struct [[eosio::table]] reserves_row {
+        uint64_t id;
+        asset reserve0;
+        asset reserve1;
+        asset liquidity;
+
+        uint64_t primary_key() const { return id; }
+    };
+    typedef eosio::multi_index< "reserves"_n, reserves_row > reserves;
+
     /**
      * Defibox stat
      */
@@ -83,8 +96,8 @@ namespace swap {
     static std::pair<asset, asset> get_reserves( const uint64_t pair_id, const symbol sort )
     {
         // table
-        swap::pairs _pairs( code, code.value );
-        auto pairs = _pairs.get( pair_id, "AiSwapLibrary: INVALID_PAIR_ID" );
+        swap::reserves _reserves( code, code.value );
+        auto pairs = _reserves.get( pair_id, "AiSwapLibrary: INVALID_PAIR_ID" );
 
         eosio::check( pairs.reserve0.symbol == sort || pairs.reserve1.symbol == sort, "AiSwapLibrary: sort symbol doesn't match");
 
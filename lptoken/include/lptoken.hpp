@@ -2,14 +2,30 @@
 #include <eosio/eosio.hpp>
 #include <eosio/system.hpp>
 #include <eosio/singleton.hpp>
+#include <eosio/binary_extension.hpp>
+#include <limits>
 
 using std::string;
+using std::vector;
 using namespace eosio;
 
 class [[eosio::contract("lptoken")]] lptoken : public contract {
 public:
    using contract::contract;
+
+   struct transfer_item {
+      name to;
+      asset quantity;
+      string memo;
+   };
+
    static constexpr name SWAP_ACCOUNT = name("eosaidaoswat");
+
+   // per-symbol transfer flags, rows created before flags existed keep the full legacy path
+   // CHECK_LOCKS stays set until `migratelock` has drained the legacy `locks` scope of the symbol
+   static constexpr uint8_t NOTIFY_SWAP = 1;
+   static constexpr uint8_t CHECK_LOCKS = 2;
+   static constexpr uint8_t LEGACY_FLAGS = NOTIFY_SWAP | CHECK_LOCKS;
    
    [[eosio::action]] 
    void close(const name &owner, const symbol &symbol);
@@ -18,6 +34,8 @@ public:
    [[eosio::action]] 
    void transfer(const name &from, const name &to, const asset &quantity, const string &memo);
    [[eosio::action]] 
+   void transfers(const name &from, const vector<transfer_item> &items, bool notify);
+   [[eosio::action]] 
    void mint(const name &to, const asset &quantity, const string &memo);
    [[eosio::action]] 
    void burn(const name &owner, const asset &quantity, const string &memo);
@@ -26,11 +44,48 @@ public:
    [[eosio::action]] 
    void lock(name owner, symbol_code sym_code, uint64_t unlock_time);
    [[eosio::action]] 
-   void unlock(name owner, symbol_code sym_code);
+   void migratelock(symbol_code sym_code, uint64_t limit);
+   [[eosio::action]] 
+   void setflags(symbol_code sym_code, uint8_t flags);
+   [[eosio::action]] 
+   void reclaim(symbol_code sym_code, vector<name> owners);
+
+   /**
+    * ## STATIC `get_balance_at`
+    *
+    * Balance of `owner` at `time` from the checkpoints of a symbol, via the `ownertime` index.
+    * Holders without checkpoints have not moved since checkpoints were introduced, so their
+    * current balance is returned. Off-chain readers can run the same query with `get_table_rows`
+    * on index 2 of `checkpoints`
+    *
+    * ### params
+    *
+    * - `{name} token_contract_account` - lptoken contract
+    * - `{name} owner` - holder
+    * - `{symbol_code} sym_code` - LP symbol code
+    * - `{uint32_t} time` - point in time (seconds since epoch)
+    */
+   static asset get_balance_at(const name &token_contract_account, const name &owner, const symbol_code &sym_code, const uint32_t time) {
+      checkpoints _checkpoints(token_contract_account, sym_code.raw());
+      auto index = _checkpoints.get_index<"ownertime"_n>();
+      auto itr = index.upper_bound(checkpoint_key(owner, time));
+      // the first checkpoint of a holder is at time 0, so any earlier row of the same owner answers
+      if (itr != index.begin()) {
+         itr--;
+         if (itr->owner == owner) return itr->balance;
+      }
+
+      stats statstable(token_contract_account, sym_code.raw());
+      const auto &st = statstable.get(sym_code.raw(), "token with symbol does not exist");
+      accounts acnts(token_contract_account, owner.value);
+      auto acnt = acnts.find(sym_code.raw());
+      return acnt == acnts.end() ? asset(0, st.supply.symbol) : acnt->balance;
+   }
 
 private:
    struct [[eosio::table]] account {
       asset balance;
+      binary_extension<uint64_t> unlock_time;
 
       uint64_t primary_key() const { return balance.symbol.code().raw(); }
    };
@@ -39,6 +94,7 @@ private:
       asset supply;
       asset max_supply;
       name issuer;
+      binary_extension<uint8_t> flags;
 
       uint64_t primary_key() const { return supply.symbol.code().raw(); }
    };
@@ -48,6 +104,7 @@ private:
       uint64_t primary_key() const { return minter.value; }
    };
 
+   // legacy lock rows, only read until migrated into `account`
    struct [[eosio::table]] lock_t {
       name owner;
       uint64_t unlock_time;
@@ -55,13 +112,45 @@ private:
       uint64_t primary_key() const { return owner.value; }
    };
 
+   // balance after each change, at most one row per holder and second
+   struct [[eosio::table]] checkpoint_t {
+      uint64_t id;
+      name owner;
+      uint32_t time;
+      asset balance;
+
+      uint64_t primary_key() const { return id; }
+      uint128_t by_owner_time() const { return checkpoint_key(owner, time); }
+   };
+
+   // one row per holder of a symbol, `bybalance` iterates from the largest balance down
+   struct [[eosio::table]] holder_t {
+      name owner;
+      asset balance;
+
+      uint64_t primary_key() const { return owner.value; }
+      uint64_t by_balance() const { return std::numeric_limits<uint64_t>::max() - balance.amount; }
+   };
+
+   static uint128_t checkpoint_key(const name &owner, const uint32_t time) {
+      return (static_cast<uint128_t>(owner.value) << 64) | time;
+   }
+
    typedef eosio::multi_index<"accounts"_n, account> accounts;
    typedef eosio::multi_index<"stat"_n, currency_stats> stats;
    typedef eosio::multi_index<"minters"_n, minter> minters;
    typedef eosio::multi_index<"locks"_n, lock_t> locks;
+   typedef eosio::multi_index<"holders"_n, holder_t,
+      indexed_by<"bybalance"_n, const_mem_fun<holder_t, uint64_t, &holder_t::by_balance>>> holders;
+   typedef eosio::multi_index<"checkpoints"_n, checkpoint_t,
+      indexed_by<"ownertime"_n, const_mem_fun<checkpoint_t, uint128_t, &checkpoint_t::by_owner_time>>> checkpoints;
 
    minters _minters = minters(_self, _self.value);
 
+   void check_legacy_lock(const symbol_code &sym_code, const name &owner, const uint8_t flags);
+   void write_checkpoint(const name &owner, const asset &pre_balance, const asset &balance, const name &ram_payer);
+   void update_holder(const name &owner, const asset &balance, const name &ram_payer);
+   void remove_holder(const name &owner, const symbol_code &sym_code);
    void sub_balance(const name &owner, const asset &value);
    void add_balance(const name &owner, const asset &value, const name &ram_payer);
 };
\ No newline at end of file
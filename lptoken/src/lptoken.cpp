@@ -16,15 +16,8 @@ void lptoken::create(const asset &maximum_supply) {
       s.supply.symbol = maximum_supply.symbol;
       s.max_supply = maximum_supply;
       s.issuer = SWAP_ACCOUNT;
+      s.flags.emplace(NOTIFY_SWAP);
    });
-
-   accounts acnts(get_self(), get_self().value);
-   auto it = acnts.find(sym.code().raw());
-   if (it == acnts.end()) {
-      acnts.emplace(get_self(), [&](auto &a) {
-         a.balance = asset{0, sym};
-      });
-   }
 }
 
 void lptoken::modify() {
@@ -96,17 +89,13 @@ void lptoken::transfer(const name &from, const name &to, const asset &quantity,
    auto sym = quantity.symbol.code();
    stats statstable(get_self(), sym.raw());
    const auto &st = statstable.get(sym.raw());
+   const uint8_t flags = st.flags.value_or(LEGACY_FLAGS);
 
-   locks _locks = locks(_self, sym.raw());
-   auto itr = _locks.find(from.value);
-   if(itr != _locks.end()) {
-      auto now_time = current_time_point().sec_since_epoch();
-      check(now_time > itr->unlock_time, "Token has locked");
-   }
+   check_legacy_lock(sym, from, flags);
 
    require_recipient(from);
    require_recipient(to);
-   if(from != SWAP_ACCOUNT && to != SWAP_ACCOUNT) {
+   if((flags & NOTIFY_SWAP) && from != SWAP_ACCOUNT && to != SWAP_ACCOUNT) {
       require_recipient(SWAP_ACCOUNT);
    }
 
@@ -121,13 +110,73 @@ void lptoken::transfer(const name &from, const name &to, const asset &quantity,
    add_balance(to, quantity, payer);
 }
 
+void lptoken::transfers(const name &from, const vector<transfer_item> &items, bool notify) {
+   require_auth(from);
+   check(items.size() > 0, "no transfers");
+   const symbol sym = items[0].quantity.symbol;
+   stats statstable(get_self(), sym.code().raw());
+   const auto &st = statstable.get(sym.code().raw());
+   check(sym == st.supply.symbol, "symbol precision mismatch");
+   const uint8_t flags = st.flags.value_or(LEGACY_FLAGS);
+
+   check_legacy_lock(sym.code(), from, flags);
+
+   int64_t total = 0;
+   for(const auto &item : items) {
+      check(from != item.to, "cannot transfer to self");
+      check(item.to != SWAP_ACCOUNT, "use transfer to send to the swap contract");
+      check(is_account(item.to), "to account does not exist");
+      check(item.quantity.is_valid(), "invalid quantity");
+      check(item.quantity.amount > 0, "must transfer positive quantity");
+      check(item.quantity.symbol == sym, "all transfers must use the same symbol");
+      check(item.memo.size() <= 256, "memo has more than 256 bytes");
+      total += item.quantity.amount;
+      check(total <= st.supply.amount, "overdrawn balance");
+   }
+
+   if(notify) require_recipient(from);
+   if((flags & NOTIFY_SWAP) && from != SWAP_ACCOUNT) {
+      require_recipient(SWAP_ACCOUNT);
+   }
+
+   sub_balance(from, asset(total, sym));
+   for(const auto &item : items) {
+      add_balance(item.to, item.quantity, from);
+      if(notify) require_recipient(item.to);
+   }
+}
+
+void lptoken::check_legacy_lock(const symbol_code &sym_code, const name &owner, const uint8_t flags) {
+   if(!(flags & CHECK_LOCKS)) return;
+   locks _locks = locks(_self, sym_code.raw());
+   auto itr = _locks.find(owner.value);
+   if(itr != _locks.end()) {
+      auto now_time = current_time_point().sec_since_epoch();
+      check(now_time > itr->unlock_time, "Token has locked");
+   }
+}
+
 void lptoken::sub_balance(const name &owner, const asset &value) {
    accounts from_acnts(get_self(), owner.value);
    const auto &from = from_acnts.get(value.symbol.code().raw(), "no balance object found");
 
    auto balance = from.balance.amount;
    check(balance >= value.amount, "overdrawn balance");
+   // an expired lock needs no unlock write
+   if(from.unlock_time.value_or(0) > 0) {
+      auto now_time = current_time_point().sec_since_epoch();
+      check(now_time > from.unlock_time.value(), "Token has locked");
+   }
   
+   write_checkpoint(owner, from.balance, from.balance - value, owner);
+   // emptied rows are released right away, the swap contract keeps its row as it is refilled on every withdraw
+   if (from.balance == value && owner != SWAP_ACCOUNT) {
+      from_acnts.erase(from);
+      remove_holder(owner, value.symbol.code());
+      return;
+   }
+
+   update_holder(owner, from.balance - value, owner);
    from_acnts.modify(from, owner, [&](auto &a) {
       a.balance -= value;
    });
@@ -137,16 +186,79 @@ void lptoken::add_balance(const name &owner, const asset &value, const name &ram
    accounts to_acnts(get_self(), owner.value);
    auto to = to_acnts.find(value.symbol.code().raw());
    if (to == to_acnts.end()) {
+      write_checkpoint(owner, asset(0, value.symbol), value, ram_payer);
+      update_holder(owner, value, ram_payer);
       to_acnts.emplace(ram_payer, [&](auto &a) {
          a.balance = value;
       });
    } else {
+      write_checkpoint(owner, to->balance, to->balance + value, ram_payer);
+      update_holder(owner, to->balance + value, ram_payer);
       to_acnts.modify(to, same_payer, [&](auto &a) {
          a.balance += value;
       });
    }
 }
 
+void lptoken::write_checkpoint(const name &owner, const asset &pre_balance, const asset &balance, const name &ram_payer) {
+   // the swap contract only holds LP in transit during withdraws
+   if (owner == SWAP_ACCOUNT) return;
+   const uint32_t now_time = current_time_point().sec_since_epoch();
+   checkpoints _checkpoints(get_self(), balance.symbol.code().raw());
+   auto index = _checkpoints.get_index<"ownertime"_n>();
+   auto itr = index.upper_bound(checkpoint_key(owner, now_time));
+   if (itr != index.begin()) {
+      itr--;
+      if (itr->owner == owner && itr->time == now_time) {
+         index.modify(itr, same_payer, [&](auto &a) {
+            a.balance = balance;
+         });
+         return;
+      }
+   }
+
+   // first change of a holder also records the balance it had before
+   if (itr == index.end() || itr->owner != owner) {
+      _checkpoints.emplace(ram_payer, [&](auto &a) {
+         a.id = _checkpoints.available_primary_key();
+         a.owner = owner;
+         a.time = 0;
+         a.balance = pre_balance;
+      });
+   }
+   _checkpoints.emplace(ram_payer, [&](auto &a) {
+      a.id = _checkpoints.available_primary_key();
+      a.owner = owner;
+      a.time = now_time;
+      a.balance = balance;
+   });
+}
+
+void lptoken::update_holder(const name &owner, const asset &balance, const name &ram_payer) {
+   // transient swap balances would rewrite a holders row on every withdraw
+   if (owner == SWAP_ACCOUNT) return;
+   holders _holders(get_self(), balance.symbol.code().raw());
+   auto itr = _holders.find(owner.value);
+   if (itr == _holders.end()) {
+      _holders.emplace(ram_payer, [&](auto &a) {
+         a.owner = owner;
+         a.balance = balance;
+      });
+   } else {
+      _holders.modify(itr, same_payer, [&](auto &a) {
+         a.balance = balance;
+      });
+   }
+}
+
+void lptoken::remove_holder(const name &owner, const symbol_code &sym_code) {
+   holders _holders(get_self(), sym_code.raw());
+   auto itr = _holders.find(owner.value);
+   if (itr != _holders.end()) {
+      _holders.erase(itr);
+   }
+}
+
 void lptoken::close(const name &owner, const symbol &symbol) {
    require_auth(owner);
    accounts acnts(get_self(), owner.value);
@@ -154,29 +266,83 @@ void lptoken::close(const name &owner, const symbol &symbol) {
    check(it != acnts.end(), "Balance row already deleted or never existed. Action won't have any effect.");
    check(it->balance.amount == 0, "Cannot close because the balance is not zero.");
    acnts.erase(it);
+   remove_holder(owner, symbol.code());
+}
+
+// erases stale zero-balance rows the contract or the issuer paid for. Contracts cannot read a row's
+// payer, so `owners` is picked off-chain from `get_table_rows --show-payer` on each `accounts` scope;
+// holder-paid rows are left for their owners to `close`
+void lptoken::reclaim(symbol_code sym_code, vector<name> owners) {
+   require_auth(get_self());
+   auto now_time = current_time_point().sec_since_epoch();
+   for (const auto &owner : owners) {
+      if (owner == SWAP_ACCOUNT) continue;
+      accounts acnts(get_self(), owner.value);
+      auto acnt = acnts.find(sym_code.raw());
+      if (acnt == acnts.end() || acnt->balance.amount != 0 || acnt->unlock_time.value_or(0) >= now_time) continue;
+      acnts.erase(acnt);
+      remove_holder(owner, sym_code);
+   }
 }
 
 void lptoken::lock(name owner, symbol_code sym_code, uint64_t unlock_time) {
    require_auth(SWAP_ACCOUNT);
-   locks _locks = locks(_self, sym_code.raw());
-   auto itr = _locks.find(owner.value);
-   if (itr == _locks.end()) {
-      _locks.emplace(_self, [&](auto &a) {
-         a.owner = owner;
-         a.unlock_time = unlock_time;
+   stats statstable(get_self(), sym_code.raw());
+   const auto &st = statstable.get(sym_code.raw(), "token with symbol does not exist");
+
+   // the contract pays only for rows it has to create, an existing row keeps its payer
+   accounts acnts(get_self(), owner.value);
+   auto acnt = acnts.find(sym_code.raw());
+   if (acnt == acnts.end()) {
+      acnts.emplace(get_self(), [&](auto &a) {
+         a.balance = asset{0, st.supply.symbol};
+         a.unlock_time.emplace(unlock_time);
       });
    } else {
-      _locks.modify(itr, same_payer, [&](auto &a) {
-         a.unlock_time = unlock_time;
+      acnts.modify(acnt, same_payer, [&](auto &a) {
+         a.unlock_time.emplace(unlock_time);
       });
    }
 }
 
-void lptoken::unlock(name owner, symbol_code sym_code) {
-   require_auth(SWAP_ACCOUNT);
+void lptoken::migratelock(symbol_code sym_code, uint64_t limit) {
+   require_auth(get_self());
+   stats statstable(get_self(), sym_code.raw());
+   const auto &st = statstable.get(sym_code.raw(), "token with symbol does not exist");
+
+   auto now_time = current_time_point().sec_since_epoch();
    locks _locks = locks(_self, sym_code.raw());
-   auto itr = _locks.find(owner.value);
-   if (itr != _locks.end()) {
-      _locks.erase(itr);
+   for (auto itr = _locks.begin(); itr != _locks.end() && limit > 0; limit--) {
+      // still active locks move into the account row, created like `lock` does when missing
+      if (itr->unlock_time >= now_time) {
+         accounts acnts(get_self(), itr->owner.value);
+         auto acnt = acnts.find(sym_code.raw());
+         if (acnt == acnts.end()) {
+            acnts.emplace(get_self(), [&](auto &a) {
+               a.balance = asset{0, st.supply.symbol};
+               a.unlock_time.emplace(itr->unlock_time);
+            });
+         } else {
+            acnts.modify(acnt, same_payer, [&](auto &a) {
+               a.unlock_time.emplace(itr->unlock_time);
+            });
+         }
+      }
+      itr = _locks.erase(itr);
    }
+
+   if (_locks.begin() == _locks.end()) {
+      statstable.modify(st, same_payer, [&](auto &s) {
+         s.flags.emplace(st.flags.value_or(LEGACY_FLAGS) & ~CHECK_LOCKS);
+      });
+   }
+}
+
+void lptoken::setflags(symbol_code sym_code, uint8_t flags) {
+   require_auth(SWAP_ACCOUNT);
+   stats statstable(get_self(), sym_code.raw());
+   const auto &st = statstable.get(sym_code.raw(), "token with symbol does not exist");
+   statstable.modify(st, same_payer, [&](auto &s) {
+      s.flags.emplace(flags);
+   });
 }
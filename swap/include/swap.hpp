@@ -1,12 +1,14 @@
 #include "../../interfaces/utils.hpp"
 #include "../../interfaces/safemath.hpp"
+#include "weighted.hpp"
 
-static string ERROR_INVALID_MEMO = "swap: invalid memo (ex: \"swap,<min_return>,<pair_ids>\" or \"deposit,<pair_id>\"";
+static string ERROR_INVALID_MEMO = "swap: invalid memo (ex: \"swap,<min_return>,<pair_ids>\", \"deposit,<pair_id>\" or \"unwrap,<pair_id>\"";
 static string ERROR_CONFIG_NOT_EXISTS = "swap: contract is under maintenance";
 
 struct memo_schema {
    name                 action;
    vector<uint64_t>     pair_ids;
+   vector<uint8_t>      out_indexes;
    int64_t              min_return;
 };
 
@@ -17,16 +19,26 @@ struct transfer_args {
     std::string memo;
 };
 
+struct transfer_item {
+    name to;
+    asset quantity;
+    std::string memo;
+};
+
 static constexpr uint32_t MAX_PROTOCOL_FEE = 100;
 static constexpr uint32_t MAX_TRADE_FEE = 50;
 static constexpr uint64_t MINIMUM_LIQUIDITY = 1000;
 static constexpr uint64_t PRICE_BASE = 10000;
+static constexpr uint64_t REWARD_PRECISION = 1000000000000;
+static constexpr uint64_t DEFAULT_EPOCH_LENGTH = 86400;
 
 static constexpr name MIN_LP_ACCOUNT = "minlpaccount"_n;
 static constexpr name PROTOCOL_FEE_ACCOUNT = "aidaoswapfet"_n;
 static constexpr name LPTOKEN_CONTRACT = "swaplptokent"_n;
 static constexpr name LPFARM_CONTRACT = "swapswapfarm"_n;
 static constexpr name POOL_MANAGER = name("wdogdeployer");
+static constexpr name REWARD_CONTRACT = name("aiaidaotoken");
+static constexpr symbol REWARD_SYMBOL = symbol("WDOGE", 3);
 
 namespace crab {
 
@@ -40,12 +52,24 @@ public:
    ACTION setpairnotif(uint64_t pair_id, vector<name> pair_notifiers);
    ACTION createpair(name creator, extended_symbol token0, extended_symbol token1);
    ACTION removepair(uint64_t pair_id);
+   ACTION syncreserve(uint64_t pair_id);
    ACTION deposit(name owner, uint64_t pair_id);
    ACTION cancel(name owner);
    ACTION lockliq(uint64_t pair_id, name owner, uint32_t day);
    ACTION swaplog( const uint64_t pair_id, const name owner, const name action, const asset quantity_in, const asset quantity_out, const asset fee, const double trade_price, const asset reserve0, const asset reserve1 );
    ACTION liquiditylog( const uint64_t pair_id, const name owner, const name action, const asset liquidity, const asset quantity0, const asset quantity1, const asset total_liquidity, const asset reserve0, const asset reserve1 );
    ACTION tokenchange(symbol_code code, uint64_t pid, name owner, uint64_t pre_amount, uint64_t now_amount);
+   ACTION setrewardper(uint64_t reward_per_second);
+   ACTION setepoch(uint64_t epoch_length);
+   ACTION addpool(uint64_t pid, uint64_t weight);
+   ACTION seedpool(uint64_t pid, uint64_t limit);
+   ACTION setweight(uint64_t pid, uint64_t weight);
+   ACTION claim(uint64_t pid, name owner);
+   ACTION setledger(uint64_t pair_id);
+   ACTION withdraw(name owner, uint64_t pair_id, asset quantity);
+   ACTION wrap(name owner, uint64_t pair_id, asset quantity);
+   ACTION lptransfer(name from, name to, asset quantity, string memo);
+   ACTION createwpool(name creator, vector<extended_symbol> tokens, vector<uint64_t> weights);
 
    using swaplog_action = eosio::action_wrapper<"swaplog"_n, &swap::swaplog>;
    using liquiditylog_action = eosio::action_wrapper<"liquiditylog"_n, &swap::liquiditylog>;
@@ -55,6 +79,8 @@ public:
    void on_transfer(name from, name to, asset quantity, std::string memo);
    [[eosio::on_notify("*::safetransfer")]]
    void on_safetransfer(name from, name to, asset quantity, std::string memo);
+   [[eosio::on_notify("*::transfers")]]
+   void on_transfers(name from, vector<transfer_item> items, bool notify);
 
 private:
    TABLE pair_t {
@@ -76,6 +102,30 @@ private:
       checksum256 asset_ids_hash() const { return utils::hash_asset_ids(token0, token1); };
    };
 
+   // compact mirror of pair reserves for cross-contract readers
+   TABLE reserve_t {
+      uint64_t id;
+      asset reserve0;
+      asset reserve1;
+      asset liquidity;
+
+      uint64_t primary_key() const { return id; }
+   };
+
+   // weighted N-token pool, shares the id space and lptoken symbols with pairs
+   TABLE wpool_t {
+      uint64_t id;
+      symbol_code lptoken_code;
+      vector<extended_symbol> tokens;
+      vector<uint64_t> weights;
+      vector<asset> reserves;
+      asset liquidity;
+      time_point_sec last_update;
+
+      uint64_t primary_key() const { return id; }
+      uint64_t lptoken_code_id() const { return lptoken_code.raw(); };
+   };
+
    TABLE liquidity_t {
       name owner;
       asset amount0;
@@ -122,6 +172,11 @@ private:
       asset total_staked;  
       bool display;
       bool enabled;
+      // pools added to pairs that already have holders stay disabled until `seedpool` has
+      // created a user row for each of them, it resumes from this owner value
+      binary_extension<uint64_t> seed_cursor;
+      // global index value the pool last settled at, set once the pool is enabled
+      binary_extension<uint128_t> reward_per_weight_paid;
       
       uint64_t primary_key() const { return pid; }
   };
@@ -139,38 +194,93 @@ private:
       uint64_t primary_key() const { return owner.value; }
   }; 
 
+   // pairs whose LP balances live in `liquidity2`, `wrapped` is the part minted on the lptoken contract
+   TABLE ledger_t {
+      uint64_t pair_id;
+      asset wrapped;
+
+      uint64_t primary_key() const { return pair_id; }
+   };
+
+   TABLE farmglobal_t {
+      uint64_t reward_per_second;
+   };
+
+   // rewards accrued per unit of enabled pool weight since the index started, pools settle against it lazily
+   TABLE reward_index_t {
+      uint128_t reward_per_weight;
+      uint64_t total_weight;
+      uint64_t last_update_time;
+   };
+
+   // rewards minted ahead for one epoch of emission, pools draw from `balance`
+   TABLE budget_t {
+      uint64_t epoch_length;
+      uint64_t balance;
+      uint64_t last_mint_time;
+   };
+
    typedef multi_index <name("balances"), balances_t,
       indexed_by < name("assetidhash"), const_mem_fun < balances_t, checksum256, &balances_t::asset_id_hash>>> balances;
    typedef multi_index<"pairs"_n, pair_t,
       indexed_by < name("lptokencode"), const_mem_fun < pair_t, uint64_t, &pair_t::lptoken_code_id>>,
       indexed_by < name("assetidshash"), const_mem_fun < pair_t, checksum256, &pair_t::asset_ids_hash>>> pairs;
+   typedef multi_index<"reserves"_n, reserve_t> reserves;
+   typedef multi_index<"wpools"_n, wpool_t,
+      indexed_by < name("lptokencode"), const_mem_fun < wpool_t, uint64_t, &wpool_t::lptoken_code_id>>> wpools;
    typedef eosio::singleton<"configs"_n, config_t> configs;
    typedef multi_index<name("configs"), config_t> configs_for_abi;
    typedef multi_index<"liquidity2"_n, liquidity_t> liquiditys;
    typedef multi_index<"pairnotifier"_n, lpnotifier_t> pairnotifiers;
    typedef multi_index<"pools"_n, pool_t> pools;
    typedef multi_index<"users"_n, user_t> users;
+   typedef multi_index<"ledgers"_n, ledger_t> ledgers;
+   typedef eosio::singleton<"farmglobals"_n, farmglobal_t> farmglobals;
+   typedef multi_index<name("farmglobals"), farmglobal_t> farmglobals_for_abi;
+   typedef eosio::singleton<"rewardindex"_n, reward_index_t> rewardindex;
+   typedef multi_index<name("rewardindex"), reward_index_t> rewardindex_for_abi;
+   typedef eosio::singleton<"budgets"_n, budget_t> budgets;
+   typedef multi_index<name("budgets"), budget_t> budgets_for_abi;
 
    pairs _pairs = pairs(_self, _self.value);
+   reserves _reserves = reserves(_self, _self.value);
+   wpools _wpools = wpools(_self, _self.value);
    configs _configs = configs(_self, _self.value);
    pairnotifiers _pairnotifiers = pairnotifiers(_self, _self.value);
+   pools _pools = pools(_self, _self.value);
+   farmglobals _farmglobals = farmglobals(_self, _self.value);
+   rewardindex _rewardindex = rewardindex(_self, _self.value);
+   budgets _budgets = budgets(_self, _self.value);
+   ledgers _ledgers = ledgers(_self, _self.value);
 
 private:
    void create( const extended_symbol value );
-   void do_swap(const name owner, const extended_asset ext_quantity, const vector<uint64_t> pair_ids, const int64_t min_return );
+   void do_swap(const name owner, const extended_asset ext_quantity, const vector<uint64_t> pair_ids, const vector<uint8_t> out_indexes, const int64_t min_return );
+   extended_asset do_weighted_swap(const name owner, const uint64_t pool_id, const extended_asset ext_in, const uint8_t out_index);
+   void add_weighted_liquidity(name owner, uint64_t pool_id);
+   void remove_weighted_liquidity(const name owner, const uint64_t pool_id, const extended_asset value);
    void do_deposit(const name owner, const uint64_t pair_id, const extended_asset value);
    void do_withdraw(const name owner, const uint64_t pair_id, const extended_asset value);
+   void withdraw_liquidity(const name owner, const uint64_t pair_id, const asset quantity);
+   void unwrap_liquidity(const name owner, const uint64_t pair_id, const asset quantity);
    void add_liquidity(name user, uint64_t pair_id);
    std::pair<uint64_t, uint64_t> mint_liquidity_token(uint64_t pair_id, name to, asset quantity, asset amount0, asset amount1);
    std::pair<uint64_t, uint64_t> burn_liquidity_token(uint64_t pair_id, name to, asset quantity, asset amount0, asset amount1);
    void update(uint64_t pair_id, int128_t balance0, int128_t balance1, int128_t reserve0, int128_t reserve1);
+   void mirror_reserves(const pair_t &pair);
    //uint64_t get_mid();
    int128_t quote(int128_t amount0, int128_t reserve0, int128_t reserve1);
    int128_t get_amount_out(int128_t amount_in, int128_t reserve_in, int128_t reserve_out);
    memo_schema parse_memo( const string memo );
    vector<uint64_t> parse_memo_pair_ids( const string memo );
+   vector<uint8_t> parse_memo_out_indexes( const string memo );
    void on_transfer_do(name from, name to, asset quantity, string memo, name code);
    void lptoken_change(name from, name to, asset quantity, string memo);
+   void liquidity_change(symbol_code code, uint64_t pair_id, name owner, uint64_t pre_amount, uint64_t now_amount);
+   reward_index_t update_index();
+   void update_pool(uint64_t pid);
+   void draw_budget(uint64_t reward);
+   bool settle_farm(uint64_t pid, name owner, uint64_t now_amount);
    void notifylog();
    void notifylp(uint64_t pair_id);
    double calculate_price( const asset value0, const asset value1 );
@@ -182,6 +292,14 @@ private:
       return config.pair_id;
    }
 
+   bool is_weighted_pool(uint64_t pool_id) {
+      return _wpools.find(pool_id) != _wpools.end();
+   }
+
+   bool is_ledger_pair(uint64_t pair_id) {
+      return _ledgers.find(pair_id) != _ledgers.end();
+   }
+
    std::pair<uint64_t, extended_symbol> get_create_lptoken() {
       uint64_t id = get_mid();
       bool valid = false;
@@ -0,0 +1,102 @@
+#pragma once
+
+// fixed-point math for weighted pools, values are scaled by BONE (1e18)
+namespace weighted {
+    static constexpr uint128_t BONE = 1000000000000000000;
+    static constexpr uint128_t BPOW_PRECISION = BONE / 10000000000;
+    static constexpr uint128_t MIN_BPOW_BASE = 1;
+    static constexpr uint128_t MAX_BPOW_BASE = 2 * BONE - 1;
+    static constexpr uint64_t MIN_WEIGHT = 1;
+    static constexpr uint64_t MAX_WEIGHT = 50;
+    static constexpr uint64_t MAX_TOTAL_WEIGHT = 50;
+    static constexpr uint64_t MAX_TOKENS = 8;
+    static constexpr uint64_t INIT_POOL_SUPPLY = 100000000;
+
+    static uint128_t bmul( const uint128_t a, const uint128_t b ) {
+        const uint128_t c0 = a * b;
+        eosio::check(a == 0 || c0 / a == b, "weighted: mul overflow");
+        return (c0 + BONE / 2) / BONE;
+    }
+
+    static uint128_t bdiv( const uint128_t a, const uint128_t b ) {
+        eosio::check(b != 0, "weighted: divide by zero");
+        const uint128_t c0 = a * BONE;
+        eosio::check(a == 0 || c0 / a == BONE, "weighted: div overflow");
+        return (c0 + b / 2) / b;
+    }
+
+    static std::pair<uint128_t, bool> bsub_sign( const uint128_t a, const uint128_t b ) {
+        return a >= b ? std::make_pair(a - b, false) : std::make_pair(b - a, true);
+    }
+
+    // a ^ n with integer n
+    static uint128_t bpowi( uint128_t a, uint128_t n ) {
+        uint128_t z = n % 2 != 0 ? a : BONE;
+        for (n /= 2; n != 0; n /= 2) {
+            a = bmul(a, a);
+            if (n % 2 != 0) z = bmul(z, a);
+        }
+        return z;
+    }
+
+    // binomial approximation of base ^ exp for 0 <= exp < 1
+    static uint128_t bpow_approx( const uint128_t base, const uint128_t exp ) {
+        const auto [ x, xneg ] = bsub_sign(base, BONE);
+        uint128_t term = BONE;
+        uint128_t sum = term;
+        bool negative = false;
+        for (uint128_t i = 1; term >= BPOW_PRECISION; i++) {
+            const uint128_t big_k = i * BONE;
+            const auto [ c, cneg ] = bsub_sign(exp, big_k - BONE);
+            term = bdiv(bmul(term, bmul(c, x)), big_k);
+            if (term == 0) break;
+            if (xneg) negative = !negative;
+            if (cneg) negative = !negative;
+            if (negative) {
+                eosio::check(sum >= term, "weighted: pow underflow");
+                sum -= term;
+            } else {
+                sum += term;
+            }
+        }
+        return sum;
+    }
+
+    static uint128_t bpow( const uint128_t base, const uint128_t exp ) {
+        eosio::check(base >= MIN_BPOW_BASE && base <= MAX_BPOW_BASE, "weighted: pow base out of range");
+        const uint128_t whole = exp / BONE * BONE;
+        const uint128_t remain = exp - whole;
+        const uint128_t whole_pow = bpowi(base, whole / BONE);
+        if (remain == 0) return whole_pow;
+        return bmul(whole_pow, bpow_approx(base, remain));
+    }
+
+    /**
+     * ## STATIC `get_amount_out`
+     *
+     * Out-given-in for a weighted product invariant
+     * amount_out = reserve_out * (1 - (reserve_in / (reserve_in + amount_in * (1 - fee))) ^ (weight_in / weight_out))
+     *
+     * ### params
+     *
+     * - `{uint64_t} amount_in` - input amount
+     * - `{uint64_t} reserve_in` - reserve of the input token
+     * - `{uint64_t} weight_in` - weight of the input token
+     * - `{uint64_t} reserve_out` - reserve of the output token
+     * - `{uint64_t} weight_out` - weight of the output token
+     * - `{uint8_t} fee` - trade fee (pips 1/100 of 1%)
+     */
+    static uint64_t get_amount_out( const uint64_t amount_in, const uint64_t reserve_in, const uint64_t weight_in, const uint64_t reserve_out, const uint64_t weight_out, const uint8_t fee ) {
+        eosio::check(amount_in > 0, "invalid input amount");
+        eosio::check(reserve_in > 0 && reserve_out > 0, "insufficient liquidity");
+        eosio::check(amount_in <= reserve_in / 2, "weighted: exceeds max in ratio");
+
+        const uint128_t weight_ratio = bdiv(weight_in, weight_out);
+        const uint128_t adjusted_in = static_cast<uint128_t>(amount_in) * (10000 - fee) / 10000;
+        const uint128_t y = bdiv(reserve_in, reserve_in + adjusted_in);
+        const uint128_t foo = bpow(y, weight_ratio);
+        const uint128_t amount_out = static_cast<uint128_t>(reserve_out) * (BONE - foo) / BONE;
+        eosio::check(amount_out > 0 && amount_out < reserve_out, "invalid output amount");
+        return static_cast<uint64_t>(amount_out);
+    }
+}
@@ -0,0 +1,133 @@
+namespace crab {
+
+// internal LP ledger: `liquidity2` holds the LP balances of ledger pairs and the
+// lptoken contract only sees tokens that owners explicitly wrap
+
+ACTION swap::setledger(uint64_t pair_id) {
+    require_auth(POOL_MANAGER);
+    auto m_itr = _pairs.require_find(pair_id, "Pair does not exist.");
+    check(m_itr->liquidity.amount == 0, "setledger: pair already has liquidity");
+    check(!is_ledger_pair(pair_id), "setledger: pair already uses internal ledger");
+
+    _ledgers.emplace(get_self(), [&](auto &a) {
+        a.pair_id = pair_id;
+        a.wrapped = asset(0, m_itr->liquidity.symbol);
+    });
+
+    // wrapped LP transfers no longer move `liquidity2` rows
+    action(permission_level{get_self(), "active"_n}, LPTOKEN_CONTRACT, "setflags"_n, make_tuple(m_itr->lptoken_code, uint8_t{0})).send();
+}
+
+ACTION swap::withdraw(name owner, uint64_t pair_id, asset quantity) {
+    require_auth(owner);
+    check(is_ledger_pair(pair_id), "Pair does not use internal ledger.");
+    auto m_itr = _pairs.require_find(pair_id, "Pair does not exist.");
+    check(quantity.symbol == m_itr->liquidity.symbol, "Invalid symbol.");
+    check(quantity.amount > 0, "must withdraw positive quantity");
+
+    liquiditys liqtable(get_self(), pair_id);
+    auto liq_itr = liqtable.require_find(owner.value, "Not fund owner");
+    check(liq_itr->token >= quantity, "overdrawn balance");
+    withdraw_liquidity(owner, pair_id, quantity);
+}
+
+ACTION swap::wrap(name owner, uint64_t pair_id, asset quantity) {
+    require_auth(owner);
+    auto l_itr = _ledgers.require_find(pair_id, "Pair does not use internal ledger.");
+    auto m_itr = _pairs.require_find(pair_id, "Pair does not exist.");
+    check(quantity.symbol == m_itr->liquidity.symbol, "Invalid symbol.");
+    check(quantity.amount > 0, "must wrap positive quantity");
+
+    liquiditys liqtable(get_self(), pair_id);
+    auto liq_itr = liqtable.require_find(owner.value, "Not fund owner");
+    auto now_time = current_time_point().sec_since_epoch();
+    check(liq_itr->unlock_time < now_time, "Now time must be >= Liquidity unlock time");
+    check(liq_itr->token >= quantity, "overdrawn balance");
+
+    uint64_t pre_amount = liq_itr->token.amount;
+    uint64_t now_amount = pre_amount - quantity.amount;
+    if (now_amount == 0) {
+        liqtable.erase(liq_itr);
+    } else {
+        int128_t amount0 = liq_itr->amount0.amount * quantity.amount / liq_itr->token.amount;
+        int128_t amount1 = liq_itr->amount1.amount * quantity.amount / liq_itr->token.amount;
+        liqtable.modify(liq_itr, same_payer, [&](auto &a) {
+            a.amount0.amount -= amount0;
+            a.amount1.amount -= amount1;
+            a.token -= quantity;
+        });
+    }
+
+    _ledgers.modify(l_itr, same_payer, [&](auto &a) {
+        a.wrapped += quantity;
+    });
+
+    auto data = make_tuple(owner, quantity, std::string("wrap liquidity token"));
+    action(permission_level{_self, "active"_n}, LPTOKEN_CONTRACT, "mint"_n, data).send();
+
+    liquidity_change( m_itr->lptoken_code, pair_id, owner, pre_amount, now_amount );
+}
+
+ACTION swap::lptransfer(name from, name to, asset quantity, string memo) {
+    check(from != to, "cannot transfer to self");
+    require_auth(from);
+    check(is_account(to), "to account does not exist");
+    check(memo.size() <= 256, "memo has more than 256 bytes");
+
+    uint64_t pair_id = utils::get_pairid_from_lptoken(quantity.symbol.code(), 2);
+    check(is_ledger_pair(pair_id), "Pair does not use internal ledger.");
+    auto m_itr = _pairs.require_find(pair_id, "Pair does not exist.");
+    check(quantity.symbol == m_itr->liquidity.symbol, "Invalid symbol.");
+    check(quantity.amount > 0, "must transfer positive quantity");
+
+    liquiditys liqtable(get_self(), pair_id);
+    auto liq_itr = liqtable.require_find(from.value, "Not fund owner");
+    auto now_time = current_time_point().sec_since_epoch();
+    check(liq_itr->unlock_time < now_time, "Token has locked");
+    check(liq_itr->token >= quantity, "overdrawn balance");
+
+    require_recipient(from);
+    require_recipient(to);
+    lptoken_change(from, to, quantity, memo);
+}
+
+// wrapped LP sent back to the swap contract is burned and credited to the owner's ledger balance
+void swap::unwrap_liquidity(const name owner, const uint64_t pair_id, const asset quantity) {
+    auto l_itr = _ledgers.require_find(pair_id, "Pair does not use internal ledger.");
+    check(l_itr->wrapped >= quantity, "unwrap: exceeds wrapped supply");
+    _ledgers.modify(l_itr, same_payer, [&](auto &a) {
+        a.wrapped -= quantity;
+    });
+
+    auto m_itr = _pairs.require_find(pair_id, "Pair does not exist.");
+    int128_t amount0 = quantity.amount * m_itr->reserve0.amount / m_itr->liquidity.amount;
+    int128_t amount1 = quantity.amount * m_itr->reserve1.amount / m_itr->liquidity.amount;
+    asset amount0_quantity{static_cast<int64_t>(amount0), m_itr->token0.get_symbol()};
+    asset amount1_quantity{static_cast<int64_t>(amount1), m_itr->token1.get_symbol()};
+
+    uint64_t pre_amount = 0;
+    liquiditys liqtable(get_self(), pair_id);
+    auto liq_itr = liqtable.find(owner.value);
+    if (liq_itr == liqtable.end()) {
+        liqtable.emplace(get_self(), [&](auto &a) {
+            a.owner = owner;
+            a.amount0 = amount0_quantity;
+            a.amount1 = amount1_quantity;
+            a.token = quantity;
+        });
+    } else {
+        pre_amount = liq_itr->token.amount;
+        liqtable.modify(liq_itr, same_payer, [&](auto &a) {
+            a.amount0 += amount0_quantity;
+            a.amount1 += amount1_quantity;
+            a.token += quantity;
+        });
+    }
+
+    auto data = make_tuple(_self, quantity, std::string("unwrap liquidity token"));
+    action(permission_level{_self, "active"_n}, LPTOKEN_CONTRACT, "burn"_n, data).send();
+
+    liquidity_change( m_itr->lptoken_code, pair_id, owner, pre_amount, pre_amount + quantity.amount );
+}
+
+}
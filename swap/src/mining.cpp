@@ -0,0 +1,234 @@
+namespace crab {
+
+// liquidity mining settled inside the swap contract for pairs that have a pool,
+// other pairs keep notifying external farms through `tokenchange`
+
+// the index is settled at the old rate first, pools pick the change up on their next update
+ACTION swap::setrewardper(uint64_t reward_per_second) {
+    require_auth(POOL_MANAGER);
+    update_index();
+
+    farmglobal_t global = _farmglobals.get_or_default(farmglobal_t{});
+    global.reward_per_second = reward_per_second;
+    _farmglobals.set(global, get_self());
+}
+
+ACTION swap::setepoch(uint64_t epoch_length) {
+    require_auth(POOL_MANAGER);
+    check(epoch_length > 0, "epoch length must be positive");
+    budget_t budget = _budgets.get_or_default(budget_t{DEFAULT_EPOCH_LENGTH, 0, 0});
+    budget.epoch_length = epoch_length;
+    _budgets.set(budget, get_self());
+}
+
+ACTION swap::addpool(uint64_t pid, uint64_t weight) {
+    require_auth(POOL_MANAGER);
+    auto m_itr = _pairs.require_find(pid, "Pair does not exist.");
+    check(_pools.find(pid) == _pools.end(), "pool already exists");
+
+    // existing holders only get a user row on their next balance change, seed them first
+    liquiditys liqtable(get_self(), pid);
+    bool has_holders = liqtable.begin() != liqtable.end();
+
+    uint64_t now_time = current_time_point().sec_since_epoch();
+    reward_index_t index = update_index();
+    if (!has_holders) {
+        index.total_weight += weight;
+        _rewardindex.set(index, get_self());
+    }
+    _pools.emplace(get_self(), [&](auto &a) {
+        a.pid = pid;
+        a.want = extended_symbol{m_itr->liquidity.symbol, LPTOKEN_CONTRACT};
+        a.weight = weight;
+        a.last_reward_time = now_time;
+        a.reward_per_share = 0;
+        a.total_rewards = 0;
+        a.shares_total = 0;
+        a.total_staked = asset(0, m_itr->liquidity.symbol);
+        a.display = true;
+        a.enabled = !has_holders;
+        a.seed_cursor.emplace(0);
+        a.reward_per_weight_paid.emplace(index.reward_per_weight);
+    });
+}
+
+ACTION swap::seedpool(uint64_t pid, uint64_t limit) {
+    require_auth(POOL_MANAGER);
+    auto pool_itr = _pools.require_find(pid, "not fund pid");
+    check(!pool_itr->enabled, "seedpool: pool already enabled");
+
+    liquiditys liqtable(get_self(), pid);
+    users _users(get_self(), pid);
+    auto liq_itr = liqtable.lower_bound(pool_itr->seed_cursor.value_or(0));
+    for (uint64_t i = 0; i < limit && liq_itr != liqtable.end(); i++, liq_itr++) {
+        if (_users.find(liq_itr->owner.value) == _users.end()) settle_farm(pid, liq_itr->owner, liq_itr->token.amount);
+    }
+
+    // rewards start once every holder has shares, so early seeded rows earn nothing extra
+    bool done = liq_itr == liqtable.end();
+    uint64_t cursor = done ? 0 : liq_itr->owner.value;
+    reward_index_t index = update_index();
+    if (done) {
+        index.total_weight += pool_itr->weight;
+        _rewardindex.set(index, get_self());
+    }
+    _pools.modify(pool_itr, same_payer, [&](auto &a) {
+        a.seed_cursor.emplace(cursor);
+        if (done) {
+            a.enabled = true;
+            a.last_reward_time = current_time_point().sec_since_epoch();
+            a.reward_per_weight_paid.emplace(index.reward_per_weight);
+        }
+    });
+}
+
+ACTION swap::setweight(uint64_t pid, uint64_t weight) {
+    require_auth(POOL_MANAGER);
+    update_pool(pid);
+    auto pool_itr = _pools.require_find(pid, "not fund pid");
+    if (pool_itr->enabled) {
+        reward_index_t index = _rewardindex.get();
+        index.total_weight = index.total_weight - pool_itr->weight + weight;
+        _rewardindex.set(index, get_self());
+    }
+    _pools.modify(pool_itr, same_payer, [&](auto &a) {
+        a.weight = weight;
+    });
+}
+
+ACTION swap::claim(uint64_t pid, name owner) {
+    require_auth(owner);
+    users _users(get_self(), pid);
+    auto user_itr = _users.require_find(owner.value, "not fund user");
+    check(user_itr->shares > 0, "user shares is 0");
+    settle_farm(pid, owner, static_cast<uint64_t>(user_itr->shares));
+}
+
+void swap::liquidity_change(symbol_code code, uint64_t pair_id, name owner, uint64_t pre_amount, uint64_t now_amount) {
+    if (settle_farm(pair_id, owner, now_amount)) return;
+
+    swap::tokenchange_action lptokenchange( get_self(), { get_self(), "active"_n });
+    lptokenchange.send( code, pair_id, owner, pre_amount, now_amount );
+}
+
+swap::reward_index_t swap::update_index() {
+    uint64_t now_time = current_time_point().sec_since_epoch();
+    reward_index_t index = _rewardindex.get_or_default(reward_index_t{0, 0, now_time});
+    if (now_time > index.last_update_time) {
+        farmglobal_t global = _farmglobals.get_or_default(farmglobal_t{});
+        index.reward_per_weight += static_cast<uint128_t>(now_time - index.last_update_time) * global.reward_per_second;
+        index.last_update_time = now_time;
+    }
+    _rewardindex.set(index, get_self());
+    return index;
+}
+
+// pools enabled before the index existed have no paid value, their first update accrues the time
+// since `last_reward_time` at the current rate and joins the index weight
+void swap::update_pool(uint64_t pid) {
+    auto pool_itr = _pools.find(pid);
+    if (pool_itr == _pools.end()) return;
+    if (!pool_itr->enabled) return;
+
+    uint64_t now_time = current_time_point().sec_since_epoch();
+    reward_index_t index = update_index();
+    uint128_t accrued = 0;
+    if (pool_itr->reward_per_weight_paid.has_value()) {
+        accrued = index.reward_per_weight - pool_itr->reward_per_weight_paid.value();
+    } else {
+        farmglobal_t global = _farmglobals.get_or_default(farmglobal_t{});
+        accrued = now_time > pool_itr->last_reward_time ? static_cast<uint128_t>(now_time - pool_itr->last_reward_time) * global.reward_per_second : 0;
+        index.total_weight += pool_itr->weight;
+        _rewardindex.set(index, get_self());
+    }
+
+    uint64_t reward = 0;
+    if (pool_itr->shares_total > 0) {
+        check(pool_itr->weight == 0 || accrued <= static_cast<uint128_t>(asset::max_amount) / pool_itr->weight, "update_pool: reward overflow");
+        reward = static_cast<uint64_t>(accrued * pool_itr->weight);
+    }
+
+    _pools.modify(pool_itr, same_payer, [&](auto &a) {
+        if (reward > 0) {
+            a.reward_per_share += static_cast<int128_t>(reward) * REWARD_PRECISION / a.shares_total;
+            a.total_rewards += reward;
+        }
+        a.seed_cursor.emplace(a.seed_cursor.value_or(0));
+        a.reward_per_weight_paid.emplace(index.reward_per_weight);
+        a.last_reward_time = now_time;
+    });
+    if (reward > 0) draw_budget(reward);
+}
+
+// mints one epoch of emission at a time when the budget runs dry
+void swap::draw_budget(uint64_t reward) {
+    budget_t budget = _budgets.get_or_default(budget_t{DEFAULT_EPOCH_LENGTH, 0, 0});
+    if (budget.balance < reward) {
+        farmglobal_t global = _farmglobals.get_or_default(farmglobal_t{});
+        reward_index_t index = _rewardindex.get();
+        uint128_t amount = static_cast<uint128_t>(global.reward_per_second) * index.total_weight * budget.epoch_length;
+        if (amount < reward - budget.balance) amount = reward - budget.balance;
+        check(amount <= asset::max_amount, "epoch budget overflow");
+
+        budget.balance += static_cast<uint64_t>(amount);
+        budget.last_mint_time = current_time_point().sec_since_epoch();
+        auto data = make_tuple(get_self(), get_self(), asset(static_cast<int64_t>(amount), REWARD_SYMBOL), string("issue token"));
+        action(permission_level{get_self(), "active"_n}, REWARD_CONTRACT, "mint"_n, data).send();
+    }
+
+    budget.balance -= reward;
+    _budgets.set(budget, get_self());
+}
+
+// returns false when the pair is not farmed natively
+bool swap::settle_farm(uint64_t pid, name owner, uint64_t now_amount) {
+    auto pool_itr = _pools.find(pid);
+    if (pool_itr == _pools.end()) return false;
+    update_pool(pid);
+
+    users _users(get_self(), pid);
+    auto user_itr = _users.find(owner.value);
+    if (user_itr == _users.end() && now_amount == 0) return true;
+
+    uint64_t now_time = current_time_point().sec_since_epoch();
+    int128_t pre_shares = 0;
+    int128_t pending = 0;
+    if (user_itr != _users.end()) {
+        pre_shares = user_itr->shares;
+        pending = user_itr->shares * pool_itr->reward_per_share / REWARD_PRECISION - user_itr->reward_debt;
+    }
+
+    int128_t reward_debt = now_amount * pool_itr->reward_per_share / REWARD_PRECISION;
+    asset staked = asset(now_amount, pool_itr->want.get_symbol());
+    if (user_itr == _users.end()) {
+        _users.emplace(get_self(), [&](auto &a) {
+            a.owner = owner;
+            a.staked = staked;
+            a.shares = now_amount;
+            a.reward_debt = reward_debt;
+            a.last_staked_time = now_time;
+        });
+    } else if (now_amount == 0) {
+        _users.erase(user_itr);
+    } else {
+        _users.modify(user_itr, same_payer, [&](auto &a) {
+            if (now_amount > pre_shares) a.last_staked_time = now_time;
+            if (now_amount < pre_shares) a.last_withdraw_time = now_time;
+            a.staked = staked;
+            a.shares = now_amount;
+            a.reward_debt = reward_debt;
+        });
+    }
+
+    _pools.modify(pool_itr, same_payer, [&](auto &a) {
+        a.shares_total += now_amount - pre_shares;
+        a.total_staked.amount = static_cast<int64_t>(a.shares_total);
+    });
+
+    if (pending > 0) {
+        utils::inline_transfer(REWARD_CONTRACT, get_self(), owner, asset(static_cast<int64_t>(pending), REWARD_SYMBOL), std::string("reward token"));
+    }
+    return true;
+}
+
+}
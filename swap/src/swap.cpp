@@ -1,5 +1,8 @@
 #include <swap.hpp>
 #include "./actions.cpp"
+#include "./mining.cpp"
+#include "./ledger.cpp"
+#include "./weighted.cpp"
 
 namespace crab {
 
@@ -97,17 +100,37 @@ ACTION swap::createpair(name creator, extended_symbol token0, extended_symbol to
         a.liquidity.symbol = liquidity_token_sym.get_symbol();
         a.last_update = current_time_point();
     });
+
+    _reserves.emplace(creator, [&](auto &a) {
+        a.id = pair_id;
+        a.reserve0.symbol = tokenA.get_symbol();
+        a.reserve1.symbol = tokenB.get_symbol();
+        a.liquidity.symbol = liquidity_token_sym.get_symbol();
+    });
 }
 
 ACTION swap::removepair(uint64_t id) {
     require_auth(POOL_MANAGER);
     auto itr = _pairs.require_find(id, "Market does not exist.");
     _pairs.erase(itr);
+
+    auto r_itr = _reserves.find(id);
+    if (r_itr != _reserves.end()) _reserves.erase(r_itr);
+}
+
+ACTION swap::syncreserve(uint64_t pair_id) {
+    require_auth(POOL_MANAGER);
+    auto m_itr = _pairs.require_find(pair_id, "Pair does not exist.");
+    mirror_reserves(*m_itr);
 }
 
 ACTION swap::deposit(name owner, uint64_t pair_id) {
     require_auth(owner);
-    add_liquidity(owner, pair_id);
+    if (is_weighted_pool(pair_id)) {
+        add_weighted_liquidity(owner, pair_id);
+    } else {
+        add_liquidity(owner, pair_id);
+    }
 }
 
 ACTION swap::cancel(name owner) {
@@ -124,12 +147,24 @@ void swap::on_transfer( name from, name to, asset quantity, string memo) {
     require_auth( from );
     name code = get_first_receiver();
     if(code == LPTOKEN_CONTRACT && from != get_self() && to != get_self()) {
-        lptoken_change(from, to, quantity, memo);
+        uint64_t pair_id = utils::get_pairid_from_lptoken(quantity.symbol.code(), 2);
+        if (!is_ledger_pair(pair_id) && !is_weighted_pool(pair_id)) lptoken_change(from, to, quantity, memo);
     }
 
     on_transfer_do(from, to, quantity, memo, code);
 }
 
+// batch LP transfers between holders, recipients can never be the swap contract
+void swap::on_transfers( name from, vector<transfer_item> items, bool notify ) {
+    require_auth( from );
+    if (get_first_receiver() != LPTOKEN_CONTRACT || from == get_self()) return;
+
+    for ( const auto &item : items ) {
+        uint64_t pair_id = utils::get_pairid_from_lptoken(item.quantity.symbol.code(), 2);
+        if (!is_ledger_pair(pair_id) && !is_weighted_pool(pair_id)) lptoken_change(from, item.to, item.quantity, item.memo);
+    }
+}
+
 void swap::lptoken_change(name from, name to, asset quantity, string memo) {
     uint64_t pair_id = utils::get_pairid_from_lptoken(quantity.symbol.code(), 2);
     auto m_itr = _pairs.require_find(pair_id, "Pair does not exist.");
@@ -139,6 +174,9 @@ void swap::lptoken_change(name from, name to, asset quantity, string memo) {
     liquiditys liqtable(get_self(), pair_id);
     auto liq_itr = liqtable.require_find(from.value, "from does not exist.");
     bool isAllTransfer = liq_itr->token == quantity;
+    uint64_t from_pre_amount = liq_itr->token.amount;
+    uint64_t from_amount = liq_itr->token.amount - quantity.amount;
+    uint64_t to_amount = quantity.amount;
     if(liq_itr != liqtable.end()) {
         if(isAllTransfer) {
             liqtable.erase(liq_itr);
@@ -152,6 +190,7 @@ void swap::lptoken_change(name from, name to, asset quantity, string memo) {
     }
     
     auto to_liq_itr = liqtable.find(to.value);
+    if (to_liq_itr != liqtable.end()) to_amount += to_liq_itr->token.amount;
     if (to_liq_itr == liqtable.end()) {
         if(isAllTransfer) {
             liqtable.emplace(get_self(), [&](auto &a) {
@@ -183,6 +222,10 @@ void swap::lptoken_change(name from, name to, asset quantity, string memo) {
             });
         }
     }
+
+    // farms track LP holders through `tokenchange`, a transfer moves shares of both sides
+    liquidity_change(m_itr->lptoken_code, pair_id, from, from_pre_amount, from_amount);
+    liquidity_change(m_itr->lptoken_code, pair_id, to, to_amount - quantity.amount, to_amount);
 }
 
 void swap::on_transfer_do(name from, name to, asset quantity, string memo, name code) {
@@ -195,15 +238,26 @@ void swap::on_transfer_do(name from, name to, asset quantity, string memo, name
     } else if (parsed_memo.action == "withdraw"_n) {
         do_withdraw(from, parsed_memo.pair_ids[0], ext_in);
     } else if (parsed_memo.action == "swap"_n) {
-        do_swap(from, ext_in, parsed_memo.pair_ids, parsed_memo.min_return);
+        do_swap(from, ext_in, parsed_memo.pair_ids, parsed_memo.out_indexes, parsed_memo.min_return);
+    } else if (parsed_memo.action == "unwrap"_n) {
+        check(code == LPTOKEN_CONTRACT, "Invalid unwrap.");
+        check(quantity.symbol == _pairs.get(parsed_memo.pair_ids[0], "Pair does not exist.").liquidity.symbol, "Invalid unwrap.");
+        unwrap_liquidity(from, parsed_memo.pair_ids[0], quantity);
     } 
 }
 
-void swap::do_swap(const name owner, const extended_asset ext_quantity, const vector<uint64_t> pair_ids, const int64_t min_return ) {
+void swap::do_swap(const name owner, const extended_asset ext_quantity, const vector<uint64_t> pair_ids, const vector<uint8_t> out_indexes, const int64_t min_return ) {
     extended_asset ext_out;
     extended_asset ext_in = ext_quantity;
     auto config = _configs.get();
-    for ( const uint64_t pair_id : pair_ids ) {
+    for ( size_t i = 0; i < pair_ids.size(); i++ ) {
+        const uint64_t pair_id = pair_ids[i];
+        if ( is_weighted_pool(pair_id) ) {
+            ext_out = do_weighted_swap(owner, pair_id, ext_in, out_indexes[i]);
+            ext_in = ext_out;
+            continue;
+        }
+
         auto ext_in_sym = ext_in.get_extended_symbol();
         auto m_itr = _pairs.require_find(pair_id, "Pair does not exist.");
         check(ext_in_sym == m_itr->token0 || ext_in_sym == m_itr->token1, "Invalid symbol");
@@ -261,9 +315,14 @@ int128_t swap::get_amount_out(int128_t amount_in, int128_t reserve_in, int128_t
 }
 
 void swap::do_deposit( const name owner, const uint64_t pair_id, const extended_asset value ) {
-    auto m_itr = _pairs.require_find(pair_id, "Pair does not exist.");
     auto ext_sym = value.get_extended_symbol();
-    check(ext_sym == m_itr->token0 || ext_sym == m_itr->token1, "Invalid deposit.");
+    if (is_weighted_pool(pair_id)) {
+        const auto tokens = _wpools.get(pair_id).tokens;
+        check(std::find(tokens.begin(), tokens.end(), ext_sym) != tokens.end(), "Invalid deposit.");
+    } else {
+        auto m_itr = _pairs.require_find(pair_id, "Pair does not exist.");
+        check(ext_sym == m_itr->token0 || ext_sym == m_itr->token1, "Invalid deposit.");
+    }
 
     balances _balances = balances(get_self(), owner.value);
     checksum256 asset_id_hash = utils::hash_asset_id(ext_sym);
@@ -285,11 +344,19 @@ void swap::do_deposit( const name owner, const uint64_t pair_id, const extended_
 }
 
 void swap::do_withdraw(const name owner, const uint64_t pair_id, const extended_asset value) {
+    if (is_weighted_pool(pair_id)) return remove_weighted_liquidity(owner, pair_id, value);
+
     auto m_itr = _pairs.require_find(pair_id, "Market does not exist.");
     auto ext_sym = value.get_extended_symbol();
     check(ext_sym.get_contract() == LPTOKEN_CONTRACT, "Invalid deposit.");
     check(ext_sym.get_symbol() == m_itr->liquidity.symbol, "Invalid deposit.");
 
+    if (is_ledger_pair(pair_id)) unwrap_liquidity(owner, pair_id, value.quantity);
+    withdraw_liquidity(owner, pair_id, value.quantity);
+}
+
+void swap::withdraw_liquidity(const name owner, const uint64_t pair_id, const asset quantity) {
+    auto m_itr = _pairs.require_find(pair_id, "Market does not exist.");
     liquiditys liqtable(get_self(), pair_id);
     auto liq_itr = liqtable.require_find(owner.value, "Not fund owner");
     uint64_t unlock_time = liq_itr->unlock_time;
@@ -298,27 +365,21 @@ void swap::do_withdraw(const name owner, const uint64_t pair_id, const extended_
 
     int128_t reserve0 = m_itr->reserve0.amount;
     int128_t reserve1 = m_itr->reserve1.amount;
-    int128_t amount0 = value.quantity.amount * reserve0 / m_itr->liquidity.amount;
-    int128_t amount1 = value.quantity.amount * reserve1 / m_itr->liquidity.amount;
+    int128_t amount0 = quantity.amount * reserve0 / m_itr->liquidity.amount;
+    int128_t amount1 = quantity.amount * reserve1 / m_itr->liquidity.amount;
     check(amount0 > 0 && amount1 > 0, "INSUFFICIENT_LIQUIDITY_BURNED");
     asset amount0_quantity{static_cast<int64_t>(amount0), m_itr->token0.get_symbol()};
     asset amount1_quantity{static_cast<int64_t>(amount1), m_itr->token1.get_symbol()};
-    auto [pre_amount, now_amount] = burn_liquidity_token(pair_id, owner, value.quantity, amount0_quantity, amount1_quantity);
+    auto [pre_amount, now_amount] = burn_liquidity_token(pair_id, owner, quantity, amount0_quantity, amount1_quantity);
     update(pair_id, reserve0 - amount0, reserve1 - amount1, reserve0, reserve1);
    
     utils::inline_transfer(m_itr->token0.get_contract(), get_self(), owner, amount0_quantity, std::string("withdraw token0 liquidity"));
     utils::inline_transfer(m_itr->token1.get_contract(), get_self(), owner, amount1_quantity, std::string("withdraw token1 liquidity"));   
 
     swap::liquiditylog_action liquiditylog( get_self(), { get_self(), "active"_n });
-    liquiditylog.send( pair_id, owner, "withdraw"_n, value.quantity, -amount0_quantity, -amount1_quantity, m_itr->liquidity - value.quantity, m_itr->reserve0 - amount0_quantity, m_itr->reserve1 - amount1_quantity );
-
-    swap::tokenchange_action lptokenchange( get_self(), { get_self(), "active"_n });
-    lptokenchange.send( m_itr->lptoken_code, m_itr->id, owner, pre_amount, now_amount );
+    liquiditylog.send( pair_id, owner, "withdraw"_n, quantity, -amount0_quantity, -amount1_quantity, m_itr->liquidity - quantity, m_itr->reserve0 - amount0_quantity, m_itr->reserve1 - amount1_quantity );
 
-    if(unlock_time > 0) {
-        auto data = make_tuple(owner, liq_itr->token.symbol.code());
-        action(permission_level{_self, "active"_n}, LPTOKEN_CONTRACT, "unlock"_n, data).send();
-    }
+    liquidity_change( m_itr->lptoken_code, m_itr->id, owner, pre_amount, now_amount );
 }
 
 void swap::add_liquidity(name owner, uint64_t pair_id) {
@@ -385,8 +446,7 @@ void swap::add_liquidity(name owner, uint64_t pair_id) {
     balances_by_hash.erase(token0_itr);
     balances_by_hash.erase(token1_itr);
 
-    swap::tokenchange_action lptokenchange( get_self(), { get_self(), "active"_n });
-    lptokenchange.send( m_itr->lptoken_code, m_itr->id, owner, pre_amount, now_amount );
+    liquidity_change( m_itr->lptoken_code, m_itr->id, owner, pre_amount, now_amount );
 }
 
 std::pair<uint64_t, uint64_t> swap::mint_liquidity_token(uint64_t pair_id, name to, asset quantity, asset amount0, asset amount1) {
@@ -416,8 +476,10 @@ std::pair<uint64_t, uint64_t> swap::mint_liquidity_token(uint64_t pair_id, name
         a.liquidity += quantity;
     });
 
-    auto data = make_tuple(to, quantity, std::string("mint liquidity token"));
-    action(permission_level{_self, "active"_n}, LPTOKEN_CONTRACT, "mint"_n, data).send();
+    if (!is_ledger_pair(pair_id)) {
+        auto data = make_tuple(to, quantity, std::string("mint liquidity token"));
+        action(permission_level{_self, "active"_n}, LPTOKEN_CONTRACT, "mint"_n, data).send();
+    }
 
     return std::pair<uint64_t, uint64_t>{ pre_amount, now_amount };
 }
@@ -439,6 +501,7 @@ void swap::lockliq(uint64_t pair_id, name owner, uint32_t day) {
         a.unlock_time = unlock_time;
     });
 
+    if (is_ledger_pair(pair_id)) return;
     auto data = make_tuple(owner, liq_itr->token.symbol.code(), unlock_time);
     action(permission_level{_self, "active"_n}, LPTOKEN_CONTRACT, "lock"_n, data).send();
 }
@@ -468,8 +531,10 @@ std::pair<uint64_t, uint64_t> swap::burn_liquidity_token(uint64_t pair_id, name
         a.liquidity -= quantity;
     });
 
-    auto data = make_tuple(_self, quantity, std::string("burn liquidity token"));
-    action(permission_level{_self, "active"_n}, LPTOKEN_CONTRACT, "burn"_n, data).send();
+    if (!is_ledger_pair(pair_id)) {
+        auto data = make_tuple(_self, quantity, std::string("burn liquidity token"));
+        action(permission_level{_self, "active"_n}, LPTOKEN_CONTRACT, "burn"_n, data).send();
+    }
 
     return std::pair<uint64_t, uint64_t>{ pre_amount, now_amount };
 }
@@ -492,6 +557,25 @@ void swap::update(uint64_t pair_id, int128_t balance0, int128_t balance1, int128
         }
         a.last_update = current_time_point();
     });
+    mirror_reserves(*m_itr);
+}
+
+void swap::mirror_reserves(const pair_t &pair) {
+    auto r_itr = _reserves.find(pair.id);
+    if (r_itr == _reserves.end()) {
+        _reserves.emplace(get_self(), [&](auto &a) {
+            a.id = pair.id;
+            a.reserve0 = pair.reserve0;
+            a.reserve1 = pair.reserve1;
+            a.liquidity = pair.liquidity;
+        });
+    } else {
+        _reserves.modify(r_itr, same_payer, [&](auto &a) {
+            a.reserve0 = pair.reserve0;
+            a.reserve1 = pair.reserve1;
+            a.liquidity = pair.liquidity;
+        });
+    }
 }
 
 // given some amount of an asset and pair reserves, returns an equivalent amount of the other asset
@@ -511,11 +595,12 @@ memo_schema swap::parse_memo( const string memo ) {
     result.min_return = 0;
     if ( result.action == "swap"_n ) {
         result.pair_ids = parse_memo_pair_ids( parts[2] );
+        result.out_indexes = parse_memo_out_indexes( parts[2] );
         check( utils::is_digit( parts[1] ), ERROR_INVALID_MEMO );
         result.min_return = std::stoll( parts[1] );
         check( result.min_return >= 0, ERROR_INVALID_MEMO );
         check( result.pair_ids.size() >= 1, ERROR_INVALID_MEMO );
-    } else if ( result.action == "deposit"_n || result.action == "withdraw"_n ) {
+    } else if ( result.action == "deposit"_n || result.action == "withdraw"_n || result.action == "unwrap"_n ) {
         result.pair_ids = parse_memo_pair_ids( parts[1] );
         check( result.pair_ids.size() == 1, ERROR_INVALID_MEMO );
     }
@@ -528,7 +613,7 @@ vector<uint64_t> swap::parse_memo_pair_ids( const string memo ) {
     vector<uint64_t> pair_ids;
     for ( const string str : utils::split(memo, "-") ) {
         uint64_t pair_id = utils::str_to_int64( str );
-        check( _pairs.find(pair_id) != _pairs.end(), "parse_memo_pair_ids: `pair_id` does not exist");
+        check( _pairs.find(pair_id) != _pairs.end() || is_weighted_pool(pair_id), "parse_memo_pair_ids: `pair_id` does not exist");
         pair_ids.push_back( pair_id );
         check( !duplicates.count( pair_id ), "parse_memo_pair_ids: invalid duplicate `pair_ids`");
         duplicates.insert( pair_id );
@@ -536,6 +621,16 @@ vector<uint64_t> swap::parse_memo_pair_ids( const string memo ) {
     return pair_ids;
 }
 
+// weighted pool hops select their output token with `<pool_id>:<token_index>`
+vector<uint8_t> swap::parse_memo_out_indexes( const string memo ) {
+    vector<uint8_t> out_indexes;
+    for ( const string str : utils::split(memo, "-") ) {
+        const size_t pos = str.find(":");
+        out_indexes.push_back( pos == string::npos ? 0 : static_cast<uint8_t>(utils::str_to_int( str.substr(pos + 1) )) );
+    }
+    return out_indexes;
+}
+
 double swap::calculate_price( const asset value0, const asset value1 )
 {
     const uint8_t precision_norm = max( value0.symbol.precision(), value1.symbol.precision() );
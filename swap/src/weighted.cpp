@@ -0,0 +1,159 @@
+namespace crab {
+
+// weighted pools live next to `pairs` and use the same ids, so a pool can be a hop
+// in a swap path, e.g. "swap,0,12-57:2" routes through pair 12 then pool 57 into its token 2
+
+ACTION swap::createwpool(name creator, vector<extended_symbol> tokens, vector<uint64_t> weights) {
+    require_auth(creator);
+    check(tokens.size() >= 2 && tokens.size() <= weighted::MAX_TOKENS, "createwpool: invalid number of tokens");
+    check(tokens.size() == weights.size(), "createwpool: tokens and weights mismatch");
+
+    uint64_t total_weight = 0;
+    vector<asset> reserves;
+    set<checksum256> duplicates;
+    for (size_t i = 0; i < tokens.size(); i++) {
+        check(weights[i] >= weighted::MIN_WEIGHT && weights[i] <= weighted::MAX_WEIGHT, "createwpool: invalid weight");
+        total_weight += weights[i];
+
+        auto supply = utils::get_supply(tokens[i]);
+        check(supply.amount > 0, "invalid token");
+        check(supply.symbol == tokens[i].get_symbol(), "invalid symbol");
+
+        checksum256 asset_id_hash = utils::hash_asset_id(tokens[i]);
+        check(!duplicates.count(asset_id_hash), "createwpool: duplicate token");
+        duplicates.insert(asset_id_hash);
+        reserves.push_back(asset(0, tokens[i].get_symbol()));
+    }
+    check(total_weight <= weighted::MAX_TOTAL_WEIGHT, "createwpool: total weight exceeds maximum");
+
+    auto [pool_id, liquidity_token_sym] = get_create_lptoken();
+    symbol_code lptoken_code = liquidity_token_sym.get_symbol().code();
+    if ( !utils::token_exists(LPTOKEN_CONTRACT, lptoken_code) ) create( liquidity_token_sym );
+
+    // weighted pool LP is not tracked in `liquidity2`, plain transfers need no swap notification
+    action(permission_level{get_self(), "active"_n}, LPTOKEN_CONTRACT, "setflags"_n, make_tuple(lptoken_code, uint8_t{0})).send();
+
+    _wpools.emplace(creator, [&](auto &a) {
+        a.id = pool_id;
+        a.lptoken_code = lptoken_code;
+        a.tokens = tokens;
+        a.weights = weights;
+        a.reserves = reserves;
+        a.liquidity.symbol = liquidity_token_sym.get_symbol();
+        a.last_update = current_time_point();
+    });
+}
+
+extended_asset swap::do_weighted_swap(const name owner, const uint64_t pool_id, const extended_asset ext_in, const uint8_t out_index) {
+    auto config = _configs.get();
+    auto w_itr = _wpools.require_find(pool_id, "Pool does not exist.");
+    auto ext_in_sym = ext_in.get_extended_symbol();
+    auto in_itr = std::find(w_itr->tokens.begin(), w_itr->tokens.end(), ext_in_sym);
+    check(in_itr != w_itr->tokens.end(), "Invalid symbol");
+    const size_t in_index = in_itr - w_itr->tokens.begin();
+    check(out_index < w_itr->tokens.size() && out_index != in_index, "Invalid output token index");
+
+    const extended_asset protocol_fee = { ext_in.quantity.amount * config.protocol_fee / 10000, ext_in_sym };
+    uint64_t amount_in = ext_in.quantity.amount - protocol_fee.quantity.amount;
+    uint64_t amount_out = weighted::get_amount_out(amount_in, w_itr->reserves[in_index].amount, w_itr->weights[in_index],
+        w_itr->reserves[out_index].amount, w_itr->weights[out_index], config.trade_fee);
+
+    _wpools.modify(w_itr, same_payer, [&](auto &a) {
+        a.reserves[in_index].amount += amount_in;
+        a.reserves[out_index].amount -= amount_out;
+        a.last_update = current_time_point();
+    });
+
+    if (protocol_fee.quantity.amount > 0) {
+        utils::inline_transfer(ext_in_sym.get_contract(), get_self(), config.fee_account, protocol_fee.quantity, std::string("swap protocol fee"));
+    }
+
+    const extended_asset ext_out = { static_cast<int64_t>(amount_out), w_itr->tokens[out_index] };
+    const double price = calculate_price( ext_in.quantity, ext_out.quantity );
+    swap::swaplog_action swaplog( get_self(), { get_self(), "active"_n });
+    swaplog.send( pool_id, owner, "swap"_n, ext_in.quantity, ext_out.quantity, protocol_fee.quantity, price, w_itr->reserves[in_index], w_itr->reserves[out_index] );
+
+    return ext_out;
+}
+
+void swap::add_weighted_liquidity(name owner, uint64_t pool_id) {
+    auto w_itr = _wpools.require_find(pool_id, "Pool does not exist.");
+    balances _balances = balances(get_self(), owner.value);
+    auto balances_by_hash = _balances.get_index<name("assetidhash")>();
+
+    const size_t size = w_itr->tokens.size();
+    vector<int128_t> desired;
+    for (const auto& token : w_itr->tokens) {
+        auto balance_itr = balances_by_hash.find(utils::hash_asset_id(token));
+        if (balance_itr == balances_by_hash.end() || balance_itr->balance.amount == 0) return;
+        desired.push_back(balance_itr->balance.amount);
+    }
+
+    int128_t supply = w_itr->liquidity.amount;
+    int128_t token_mint = 0;
+    vector<int128_t> amounts = desired;
+    if (supply == 0) {
+        token_mint = weighted::INIT_POOL_SUPPLY - MINIMUM_LIQUIDITY;
+    } else {
+        token_mint = desired[0] * supply / w_itr->reserves[0].amount;
+        for (size_t i = 1; i < size; i++) {
+            token_mint = std::min(token_mint, desired[i] * supply / w_itr->reserves[i].amount);
+        }
+        for (size_t i = 0; i < size; i++) {
+            amounts[i] = (w_itr->reserves[i].amount * token_mint + supply - 1) / supply;
+            check(amounts[i] <= desired[i], "math error");
+        }
+    }
+    check(token_mint > 0, "INSUFFICIENT_LIQUIDITY_MINTED");
+
+    for (size_t i = 0; i < size; i++) {
+        if (desired[i] > amounts[i])
+            utils::inline_transfer(w_itr->tokens[i].get_contract(), get_self(), owner, asset(desired[i] - amounts[i], w_itr->tokens[i].get_symbol()), std::string("extra deposit refund"));
+        balances_by_hash.erase(balances_by_hash.find(utils::hash_asset_id(w_itr->tokens[i])));
+    }
+
+    asset mint_quantity{static_cast<int64_t>(token_mint), w_itr->liquidity.symbol};
+    asset total_mint = supply == 0 ? asset(weighted::INIT_POOL_SUPPLY, w_itr->liquidity.symbol) : mint_quantity;
+    _wpools.modify(w_itr, same_payer, [&](auto &a) {
+        for (size_t i = 0; i < size; i++) a.reserves[i].amount += amounts[i];
+        a.liquidity += total_mint;
+        a.last_update = current_time_point();
+    });
+
+    if (supply == 0) {
+        auto data = make_tuple(MIN_LP_ACCOUNT, asset(MINIMUM_LIQUIDITY, w_itr->liquidity.symbol), std::string("mint liquidity token")); // permanently lock the first MINIMUM_LIQUIDITY tokens
+        action(permission_level{_self, "active"_n}, LPTOKEN_CONTRACT, "mint"_n, data).send();
+    }
+    auto data = make_tuple(owner, mint_quantity, std::string("mint liquidity token"));
+    action(permission_level{_self, "active"_n}, LPTOKEN_CONTRACT, "mint"_n, data).send();
+}
+
+void swap::remove_weighted_liquidity(const name owner, const uint64_t pool_id, const extended_asset value) {
+    auto w_itr = _wpools.require_find(pool_id, "Pool does not exist.");
+    check(value.contract == LPTOKEN_CONTRACT, "Invalid deposit.");
+    check(value.quantity.symbol == w_itr->liquidity.symbol, "Invalid deposit.");
+
+    const size_t size = w_itr->tokens.size();
+    int128_t supply = w_itr->liquidity.amount;
+    vector<asset> amounts;
+    for (size_t i = 0; i < size; i++) {
+        int128_t amount = value.quantity.amount * w_itr->reserves[i].amount / supply;
+        check(amount > 0, "INSUFFICIENT_LIQUIDITY_BURNED");
+        amounts.push_back(asset(static_cast<int64_t>(amount), w_itr->tokens[i].get_symbol()));
+    }
+
+    _wpools.modify(w_itr, same_payer, [&](auto &a) {
+        for (size_t i = 0; i < size; i++) a.reserves[i] -= amounts[i];
+        a.liquidity -= value.quantity;
+        a.last_update = current_time_point();
+    });
+
+    auto data = make_tuple(_self, value.quantity, std::string("burn liquidity token"));
+    action(permission_level{_self, "active"_n}, LPTOKEN_CONTRACT, "burn"_n, data).send();
+
+    for (size_t i = 0; i < size; i++) {
+        utils::inline_transfer(w_itr->tokens[i].get_contract(), get_self(), owner, amounts[i], std::string("withdraw liquidity"));
+    }
+}
+
+}